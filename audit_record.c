@@ -0,0 +1,694 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <bsm/libbsm.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audit_record.h"
+#include "compat.h"
+
+/*
+ * Every AUT_HEADER variant starts with the token id, the record byte count
+ * and the version, followed by the event type. See audit.log(5).
+ */
+#define	AU_HDR_SIZE_OFF		1
+#define	AU_HDR_EVENT_OFF	(1 + sizeof(uint32_t) + 1)
+#define	AU_HDR_MINLEN		(AU_HDR_EVENT_OFF + sizeof(uint16_t))
+
+/* Token id, magic and record byte count */
+#define	AU_TRAILER_LEN		(1 + sizeof(uint16_t) + sizeof(uint32_t))
+
+/* Token id, error number and the 32 or 64 bit return value */
+#define	AU_RET32_LEN		(1 + 1 + sizeof(uint32_t))
+#define	AU_RET64_LEN		(1 + 1 + sizeof(uint64_t))
+
+static bool
+is_header(u_char id)
+{
+	switch (id) {
+	case AUT_HEADER32:
+	case AUT_HEADER32_EX:
+	case AUT_HEADER64:
+	case AUT_HEADER64_EX:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Byte count of the token at 'buf' for the fixed or length prefixed tokens
+ * the kernel writes into NFS records, read without parsing the token, or
+ * 0 if it is of another kind or runs past 'avail'. See audit.log(5).
+ */
+static size_t
+tok_len(const u_char *buf, size_t avail)
+{
+	size_t len;
+
+	switch (buf[0]) {
+	case AUT_HEADER32:
+		len = 1 + 4 + 1 + 2 + 2 + 4 + 4;
+		break;
+	case AUT_HEADER64:
+		len = 1 + 4 + 1 + 2 + 2 + 8 + 8;
+		break;
+	case AUT_SUBJECT32:
+		len = 1 + 7 * 4 + 4 + 4;
+		break;
+	case AUT_SUBJECT64:
+		len = 1 + 7 * 4 + 8 + 4;
+		break;
+	case AUT_ATTR32:
+		len = 1 + 4 * 4 + 8 + 4;
+		break;
+	case AUT_ATTR64:
+		len = 1 + 4 * 4 + 8 + 8;
+		break;
+	case AUT_RETURN32:
+		len = AU_RET32_LEN;
+		break;
+	case AUT_RETURN64:
+		len = AU_RET64_LEN;
+		break;
+	case AUT_PATH:
+	case AUT_TEXT:
+		if (avail < 1 + 2)
+			return (0);
+		len = 1 + 2 + be16dec(buf + 1);
+		break;
+	case AUT_ARG32:
+		if (avail < 1 + 1 + 4 + 2)
+			return (0);
+		len = 1 + 1 + 4 + 2 + be16dec(buf + 1 + 1 + 4);
+		break;
+	case AUT_ARG64:
+		if (avail < 1 + 1 + 8 + 2)
+			return (0);
+		len = 1 + 1 + 8 + 2 + be16dec(buf + 1 + 1 + 8);
+		break;
+	default:
+		return (0);
+	}
+	return (len <= avail ? len : 0);
+}
+
+void
+au_match_init(struct au_match *match, int event, int status)
+{
+	match->event = event;
+	match->status = status;
+	match->text = NULL;
+	match->euid = AU_MATCH_ANYUID;
+	match->regex = NULL;
+	match->prefix = NULL;
+	match->prefixlen = 0;
+}
+
+/*
+ * Length of the literal string that every match of the extended regex
+ * 'regex' contains, e.g. "nfsrvd_write" for "nfsrvd_write.*return,success".
+ * Returns 0 if there is no such string, like for top level alternations.
+ */
+static size_t
+regex_prefixlen(const char *regex)
+{
+	size_t len;
+
+	if (strchr(regex, '|') != NULL)
+		return (0);
+
+	len = strcspn(regex, ".[]()*+?{}^$\\");
+	/* A quantifier makes the last literal character optional */
+	if (len > 0 && regex[len] != '\0' && strchr("*?{", regex[len]) != NULL)
+		len--;
+	return (len);
+}
+
+/*
+ * Compile 'regex' into "match" once, so that checking a record costs a
+ * substring scan for its literal prefix and a regexec(3) only when that
+ * prefix is found.
+ */
+int
+au_match_regex(struct au_match *match, const char *regex)
+{
+	const char *start = regex;
+
+	if (regcomp(&match->re, regex, REG_EXTENDED | REG_NOSUB) != 0)
+		return (-1);
+
+	/* An anchor at the start does not change the literal that follows */
+	if (*start == '^')
+		start++;
+	match->prefixlen = regex_prefixlen(start);
+	if ((match->prefix = strndup(start, match->prefixlen)) == NULL) {
+		regfree(&match->re);
+		return (-1);
+	}
+	match->regex = regex;
+	return (0);
+}
+
+/*
+ * Check the rendered record 'text' of 'len' bytes against the regex of
+ * "match", trivially true if it has none.
+ */
+bool
+au_match_text(const struct au_match *match, const char *text, size_t len)
+{
+	regmatch_t pmatch[1];
+
+	if (match->regex == NULL)
+		return (true);
+	if (match->prefixlen != 0 &&
+	    memmem(text, len, match->prefix, match->prefixlen) == NULL)
+		return (false);
+
+	/* Bound the search by 'len' as well, the text needs no terminator */
+	pmatch[0].rm_so = 0;
+	pmatch[0].rm_eo = len;
+	return (regexec(&match->re, text, 1, pmatch, REG_STARTEND) == 0);
+}
+
+void
+au_match_free(struct au_match *match)
+{
+	if (match->regex == NULL)
+		return;
+	regfree(&match->re);
+	free(match->prefix);
+	match->regex = NULL;
+	match->prefix = NULL;
+}
+
+/*
+ * Returns the event id of the record in 'buf' straight from its header
+ * token, or -1 if the record does not start with one.
+ */
+int
+au_rec_event(const u_char *buf, size_t reclen)
+{
+	if (reclen < AU_HDR_MINLEN || !is_header(buf[0]))
+		return (-1);
+	return (be16dec(buf + AU_HDR_EVENT_OFF));
+}
+
+/*
+ * Returns the error number of the AUT_RETURN token of the record in 'buf',
+ * 0 on success, or -1 if it has none. The tokens are only stepped over by
+ * their byte count, read in place for those the kernel usually writes, so
+ * a return token is never mistaken for bytes inside a path or text. Only
+ * tokens of other kinds are parsed with au_fetch_tok(3) to find their end.
+ */
+int
+au_rec_status(u_char *buf, size_t reclen)
+{
+	tokenstr_t token;
+	size_t bytes = 0, len;
+
+	while (bytes < reclen) {
+		if ((len = tok_len(buf + bytes, reclen - bytes)) == 0) {
+			if (au_fetch_tok(&token, buf + bytes,
+			    reclen - bytes) == -1)
+				return (-1);
+			len = token.len;
+		}
+		if (buf[bytes] == AUT_RETURN32 || buf[bytes] == AUT_RETURN64)
+			return (buf[bytes + 1]);
+		bytes += len;
+	}
+	return (-1);
+}
+
+/*
+ * Byte count of the record at 'buf' if a complete one starts there, that
+ * is a header token whose byte count is repeated by the trailer token at
+ * the end. Returns 0 otherwise.
+ */
+size_t
+au_rec_len(const u_char *buf, size_t avail)
+{
+	const u_char *tail;
+	size_t len;
+
+	if (avail < AU_HDR_MINLEN + AU_TRAILER_LEN || !is_header(buf[0]))
+		return (0);
+	len = be32dec(buf + AU_HDR_SIZE_OFF);
+	if (len < AU_HDR_MINLEN + AU_TRAILER_LEN || len > avail)
+		return (0);
+	tail = buf + len - AU_TRAILER_LEN;
+	if (tail[0] != AUT_TRAILER || be16dec(tail + 1) != AUT_TRAILER_MAGIC ||
+	    be32dec(tail + 1 + sizeof(uint16_t)) != len)
+		return (0);
+	return (len);
+}
+
+/*
+ * Offset of the first record boundary in the 'len' bytes at 'buf', which
+ * may start in the middle of a record, or 'len' if there is none. It lets
+ * a trail be split at arbitrary offsets.
+ */
+size_t
+au_rec_sync(const u_char *buf, size_t len)
+{
+	size_t off;
+
+	for (off = 0; off < len; off++) {
+		if (au_rec_len(buf + off, len - off) != 0)
+			return (off);
+	}
+	return (len);
+}
+
+/*
+ * Build into 'buf', of '*reclen' bytes, the record of an NFS server call
+ * shaped like the kernel writes it: the subject of 'uid' and 'gid', a path
+ * token for each of 'path1' and 'path2' which is not NULL and the return
+ * of 'error'. Returns 0 and the byte count of the record in '*reclen', -1
+ * if it does not fit.
+ */
+int
+au_rec_build(u_char *buf, size_t *reclen, int event, uid_t uid, gid_t gid,
+    int error, const char *path1, const char *path2)
+{
+	au_tid_t tid;
+	int aud;
+
+	if ((aud = au_open()) == -1)
+		return (-1);
+	memset(&tid, 0, sizeof(tid));
+	au_write(aud, au_to_subject32(uid, uid, gid, uid, gid, getpid(), 0,
+	    &tid));
+	if (path1 != NULL)
+		au_write(aud, au_to_path(path1));
+	if (path2 != NULL)
+		au_write(aud, au_to_path(path2));
+	au_write(aud, au_to_return32((char)error, error == 0 ? 0 : -1));
+	return (au_close_buffer(aud, (short)event, buf, reclen));
+}
+
+static bool
+match_string(const char *str, size_t len, const char *text)
+{
+	if (str == NULL)
+		return (false);
+	return (memmem(str, len, text, strlen(text)) != NULL);
+}
+
+/*
+ * Check the record in 'buf' against "match". The event id is compared
+ * first, from the fixed header offset, so that most of the records of no
+ * interest are rejected without looking at a single token. The return
+ * status comes next, from au_rec_status(), which steps over every token up
+ * to the return token; the text and subject tokens are parsed last.
+ */
+bool
+au_match_rec(const struct au_match *match, u_char *buf, size_t reclen)
+{
+	tokenstr_t token;
+	size_t bytes = 0;
+	bool text, subject;
+	int ret;
+
+	if (match->event != AU_MATCH_ANYEVENT &&
+	    au_rec_event(buf, reclen) != match->event)
+		return (false);
+
+	if (match->status != AU_MATCH_ANY) {
+		if ((ret = au_rec_status(buf, reclen)) == -1)
+			return (false);
+		if ((match->status == AU_MATCH_SUCCESS) != (ret == 0))
+			return (false);
+	}
+
+	text = (match->text == NULL);
+	subject = (match->euid == AU_MATCH_ANYUID);
+
+	while (bytes < reclen && !(text && subject)) {
+		if (au_fetch_tok(&token, buf + bytes, reclen - bytes) == -1)
+			return (false);
+
+		switch (token.id) {
+		case AUT_PATH:
+			if (!text)
+				text = match_string(token.tt.path.path,
+				    token.tt.path.len, match->text);
+			break;
+		case AUT_TEXT:
+			if (!text)
+				text = match_string(token.tt.text.text,
+				    token.tt.text.len, match->text);
+			break;
+		case AUT_SUBJECT32:
+			subject |= (token.tt.subj32.euid == match->euid);
+			break;
+		case AUT_SUBJECT32_EX:
+			subject |= (token.tt.subj32_ex.euid == match->euid);
+			break;
+		case AUT_SUBJECT64:
+			subject |= (token.tt.subj64.euid == match->euid);
+			break;
+		case AUT_SUBJECT64_EX:
+			subject |= (token.tt.subj64_ex.euid == match->euid);
+			break;
+		}
+		bytes += token.len;
+	}
+
+	return (text && subject);
+}
+
+/*
+ * Find the first of the "nmatch" records in "matches" not found yet that
+ * the record in 'buf' satisfies. It is rendered into "arena" at most once
+ * for all the regexes tried. If "ordered", only the next record in
+ * sequence is tried, so that the others seen too early do not count.
+ * Returns its index, -1 if there is none or -2 if the record is malformed.
+ */
+int
+au_match_next(const struct au_match *matches, const bool found[], int nmatch,
+    bool ordered, struct au_arena *arena, u_char *buf, size_t reclen)
+{
+	const char *text = NULL;
+	int i;
+
+	for (i = 0; i < nmatch; i++) {
+		if (found[i])
+			continue;
+		if (au_match_rec(&matches[i], buf, reclen)) {
+			if (matches[i].regex == NULL)
+				return (i);
+			if (text == NULL &&
+			    (text = au_arena_render(arena, buf, reclen)) == NULL)
+				return (-2);
+			if (au_match_text(&matches[i], text, arena->len))
+				return (i);
+		}
+		if (ordered)
+			break;
+	}
+	return (-1);
+}
+
+/*
+ * Render "match" in a human readable form for failure messages.
+ */
+void
+au_match_describe(const struct au_match *match, char *buf, size_t size)
+{
+	struct au_event_ent *ev = NULL;
+	const char *status[] = { "any", "success", "failure" };
+
+	if (match->event != AU_MATCH_ANYEVENT)
+		ev = getauevnum(match->event);
+	if (match->event == AU_MATCH_ANYEVENT &&
+	    match->status == AU_MATCH_ANY && match->text == NULL &&
+	    match->euid == AU_MATCH_ANYUID && match->regex != NULL) {
+		snprintf(buf, size, "%s", match->regex);
+		return;
+	}
+	snprintf(buf, size, "event %s(%d) return,%s text %s euid %d%s%s",
+	    ev != NULL ? ev->ae_name : "", match->event,
+	    status[match->status], match->text != NULL ? match->text : "*",
+	    (int)match->euid, match->regex != NULL ? " regex " : "",
+	    match->regex != NULL ? match->regex : "");
+}
+
+int
+au_arena_init(struct au_arena *arena)
+{
+	arena->buf = NULL;
+	arena->len = 0;
+	arena->stream = open_memstream(&arena->buf, &arena->len);
+	return (arena->stream == NULL ? -1 : 0);
+}
+
+void
+au_arena_free(struct au_arena *arena)
+{
+	fclose(arena->stream);
+	free(arena->buf);
+	arena->buf = NULL;
+}
+
+/*
+ * Render every token of the record in 'buf' in the default form of
+ * praudit(1), comma delimited. Returns the NUL terminated text, valid
+ * until the next call, or NULL if the record is malformed.
+ */
+const char *
+au_arena_render(struct au_arena *arena, u_char *buf, size_t reclen)
+{
+	tokenstr_t token;
+	char del[] = ",";
+	size_t bytes = 0;
+
+	rewind(arena->stream);
+	while (bytes < reclen) {
+		if (au_fetch_tok(&token, buf + bytes, reclen - bytes) == -1)
+			return (NULL);
+		au_print_flags_tok(arena->stream, &token, del, AU_OFLAG_NONE);
+		bytes += token.len;
+	}
+
+	/*
+	 * Flushing updates 'buf' and 'len', but after the rewind the text of
+	 * a longer record may still follow 'len', so terminate it here. The
+	 * stream always keeps room for the NUL past 'len'.
+	 */
+	if (fflush(arena->stream) != 0)
+		return (NULL);
+	arena->buf[arena->len] = '\0';
+	return (arena->buf);
+}
+
+int
+au_framer_init(struct au_framer *framer, int fd)
+{
+	framer->fd = fd;
+	framer->capfd = -1;
+	framer->mapped = false;
+	framer->start = framer->end = 0;
+	framer->size = AU_FRAMER_BUFSIZE;
+	if ((framer->buf = malloc(framer->size)) == NULL)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Frame the records of a capture or trail file mapped in place of a read
+ * buffer. There is nothing left to read, all the records are pending.
+ */
+int
+au_framer_map(struct au_framer *framer, const char *path)
+{
+	struct stat sb;
+	void *addr = NULL;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	if (fstat(fd, &sb) == -1 || (sb.st_size != 0 &&
+	    (addr = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0)) ==
+	    MAP_FAILED)) {
+		close(fd);
+		return (-1);
+	}
+	close(fd);
+	if (addr != NULL)
+		posix_madvise(addr, sb.st_size, POSIX_MADV_SEQUENTIAL);
+
+	framer->fd = -1;
+	framer->capfd = -1;
+	framer->mapped = true;
+	framer->buf = addr;
+	framer->size = framer->end = sb.st_size;
+	framer->start = 0;
+	return (0);
+}
+
+/*
+ * Append the raw bytes of every subsequent read to the file 'path', so
+ * that the exact record stream can be replayed later.
+ */
+int
+au_framer_capture(struct au_framer *framer, const char *path)
+{
+	framer->capfd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	return (framer->capfd == -1 ? -1 : 0);
+}
+
+void
+au_framer_free(struct au_framer *framer)
+{
+	if (framer->capfd != -1)
+		close(framer->capfd);
+	if (framer->mapped && framer->buf != NULL)
+		munmap(framer->buf, framer->size);
+	else if (!framer->mapped)
+		free(framer->buf);
+	framer->buf = NULL;
+}
+
+static int
+capture(struct au_framer *framer, const u_char *buf, size_t len)
+{
+	ssize_t nwritten;
+
+	while (len > 0) {
+		if ((nwritten = write(framer->capfd, buf, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		buf += nwritten;
+		len -= nwritten;
+	}
+	return (0);
+}
+
+/*
+ * Discard everything read so far, e.g. after AUDITPIPE_FLUSH.
+ */
+void
+au_framer_reset(struct au_framer *framer)
+{
+	framer->start = framer->end = 0;
+}
+
+/*
+ * Byte count of the record at the start of the unconsumed data, 0 if its
+ * header has not been read completely yet.
+ */
+static size_t
+framer_reclen(const struct au_framer *framer)
+{
+	const u_char *rec = framer->buf + framer->start;
+
+	if (framer->end - framer->start < AU_HDR_SIZE_OFF + sizeof(uint32_t))
+		return (0);
+	return (be32dec(rec + AU_HDR_SIZE_OFF));
+}
+
+/*
+ * Returns true if a complete record is buffered. Such records are
+ * invisible to poll(2) on the descriptor, so they must be consumed before
+ * waiting on it again.
+ */
+bool
+au_framer_pending(const struct au_framer *framer)
+{
+	size_t reclen = framer_reclen(framer);
+
+	return (reclen != 0 && framer->end - framer->start >= reclen);
+}
+
+/*
+ * Read as much as is available from the descriptor with a single read(2).
+ * The partial record at the end of the buffer, if any, is moved to the
+ * front and the buffer only grows for records larger than itself, or when
+ * it is full of records not consumed yet. A return of 0 is thus always the
+ * end of file.
+ */
+ssize_t
+au_framer_fill(struct au_framer *framer)
+{
+	size_t reclen, size;
+	ssize_t nread;
+	u_char *buf;
+
+	if (framer->mapped)
+		return (0);
+	if (framer->start == framer->end) {
+		framer->start = framer->end = 0;
+	} else if (framer->start != 0) {
+		memmove(framer->buf, framer->buf + framer->start,
+		    framer->end - framer->start);
+		framer->end -= framer->start;
+		framer->start = 0;
+	}
+
+	reclen = framer_reclen(framer);
+	size = reclen > framer->size ? reclen : framer->size;
+	if (framer->end == size)
+		size *= 2;
+	if (size != framer->size) {
+		if ((buf = realloc(framer->buf, size)) == NULL)
+			return (-1);
+		framer->buf = buf;
+		framer->size = size;
+	}
+
+	do {
+		nread = read(framer->fd, framer->buf + framer->end,
+		    framer->size - framer->end);
+	} while (nread == -1 && errno == EINTR);
+	if (nread > 0) {
+		if (framer->capfd != -1 &&
+		    capture(framer, framer->buf + framer->end, nread) == -1)
+			return (-1);
+		framer->end += nread;
+	}
+	return (nread);
+}
+
+/*
+ * Hand out the next complete record without copying it. The record stays
+ * valid until the next call to au_framer_fill(). Returns 1 if a record was
+ * found, 0 if more data has to be read first and -1 if the data does not
+ * start with a header token.
+ */
+int
+au_framer_next(struct au_framer *framer, u_char **buf, size_t *reclen)
+{
+	size_t len;
+
+	if (framer->start == framer->end)
+		return (0);
+	if (!is_header(framer->buf[framer->start]))
+		return (-1);
+	if ((len = framer_reclen(framer)) == 0)
+		return (0);
+	if (len < AU_HDR_MINLEN)
+		return (-1);
+	if (framer->end - framer->start < len)
+		return (0);
+
+	*buf = framer->buf + framer->start;
+	*reclen = len;
+	framer->start += len;
+	return (1);
+}
@@ -0,0 +1,117 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef _AUDIT_RECORD_H_
+#define _AUDIT_RECORD_H_
+
+#include <sys/types.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Expected status of the AUT_RETURN token */
+#define	AU_MATCH_ANY		0
+#define	AU_MATCH_SUCCESS	1
+#define	AU_MATCH_FAILURE	2
+
+#define	AU_MATCH_ANYEVENT	(-1)
+#define	AU_MATCH_ANYUID		((uid_t)-1)
+
+/*
+ * Criteria checked directly against the BSM tokens of an audit record,
+ * so that records of no interest are discarded without rendering them.
+ * An optional regex is then matched against the rendered record. It is
+ * compiled once by au_match_regex() along with its literal prefix, which
+ * is searched for first with memmem(3).
+ */
+struct au_match {
+	int	event;		/* AUE_* event id of the AUT_HEADER */
+	int	status;		/* AU_MATCH_* status of the AUT_RETURN */
+	const char	*text;	/* substring of an AUT_PATH or AUT_TEXT */
+	uid_t	euid;		/* effective uid of the AUT_SUBJECT */
+	const char	*regex;	/* regex for the rendered record, or NULL */
+	regex_t	re;
+	char	*prefix;	/* literal every match of regex starts with */
+	size_t	prefixlen;
+};
+
+/* Initial size of the framer buffer, enough for a burst of NFS records */
+#define	AU_FRAMER_BUFSIZE	(64 * 1024)
+
+/*
+ * Reads an audit pipe or trail in large chunks into a reusable buffer and
+ * splits it into records by the byte count of their header token.
+ */
+struct au_framer {
+	int	fd;
+	int	capfd;		/* raw copy of everything read, or -1 */
+	bool	mapped;		/* buf is a capture file mapped by mmap(2) */
+	u_char	*buf;
+	size_t	size;		/* allocated size of buf */
+	size_t	start;		/* first byte not yet consumed */
+	size_t	end;		/* one past the last byte read */
+};
+
+/*
+ * Growable buffer that records are rendered into as text. It is rewound,
+ * not freed, between records, so it stops allocating once it has grown to
+ * fit the longest record seen.
+ */
+struct au_arena {
+	char	*buf;
+	size_t	len;
+	FILE	*stream;
+};
+
+void au_match_init(struct au_match *, int, int);
+int au_rec_event(const u_char *, size_t);
+int au_rec_status(u_char *, size_t);
+size_t au_rec_len(const u_char *, size_t);
+size_t au_rec_sync(const u_char *, size_t);
+int au_rec_build(u_char *, size_t *, int, uid_t, gid_t, int, const char *,
+    const char *);
+bool au_match_rec(const struct au_match *, u_char *, size_t);
+void au_match_describe(const struct au_match *, char *, size_t);
+int au_match_regex(struct au_match *, const char *);
+bool au_match_text(const struct au_match *, const char *, size_t);
+void au_match_free(struct au_match *);
+int au_match_next(const struct au_match *, const bool [], int, bool,
+    struct au_arena *, u_char *, size_t);
+
+int au_arena_init(struct au_arena *);
+void au_arena_free(struct au_arena *);
+const char *au_arena_render(struct au_arena *, u_char *, size_t);
+
+int au_framer_init(struct au_framer *, int);
+int au_framer_map(struct au_framer *, const char *);
+int au_framer_capture(struct au_framer *, const char *);
+void au_framer_free(struct au_framer *);
+void au_framer_reset(struct au_framer *);
+bool au_framer_pending(const struct au_framer *);
+ssize_t au_framer_fill(struct au_framer *);
+int au_framer_next(struct au_framer *, u_char **, size_t *);
+
+#endif	/* _AUDIT_RECORD_H_ */
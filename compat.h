@@ -0,0 +1,78 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Shims for the few FreeBSD interfaces the tools that read or replay
+ * audit records, nfs-audit-standin and the tests run against it use, so
+ * that they also build on other systems with OpenBSM and libnfs, see
+ * GNUmakefile. Include it after the system headers.
+ */
+
+#ifndef _COMPAT_H_
+#define _COMPAT_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#ifdef __FreeBSD__
+#include <sys/endian.h>
+#else
+static inline uint16_t
+be16dec(const void *pp)
+{
+	const uint8_t *p = pp;
+
+	return ((uint16_t)(p[0] << 8 | p[1]));
+}
+
+static inline uint32_t
+be32dec(const void *pp)
+{
+	const uint8_t *p = pp;
+
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+static inline int
+flsll(long long mask)
+{
+	return (mask == 0 ? 0 :
+	    64 - __builtin_clzll((unsigned long long)mask));
+}
+#endif
+
+#ifndef __dead2
+#define	__dead2		__attribute__((__noreturn__))
+#endif
+#ifndef __unused
+#define	__unused	__attribute__((__unused__))
+#endif
+#ifndef nitems
+#define	nitems(x)	(sizeof((x)) / sizeof((x)[0]))
+#endif
+
+#endif	/* _COMPAT_H_ */
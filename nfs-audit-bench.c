@@ -0,0 +1,690 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Load generator for the NFS server of the test host. Each thread mounts
+ * its own context of a directory the fixture of the tests exports to the
+ * bench alone, or of the -d directory served by the nfs-audit-standin
+ * named by NFSAUDIT_STANDIN, and issues a weighted mix
+ * of NFSv3 procedures back to back for a fixed duration. The throughput
+ * and the latency percentiles of every procedure are reported at the end,
+ * so that the cost of audit can be followed as threads are added.
+ *
+ * With -a, the same workload is run in rounds with the "nfs" and then the
+ * "no" preselection flags on an auditpipe(4) of the bench, which is kept
+ * drained, and the other way round in the next round. Each run follows a
+ * warm-up under the same flags which is not measured. The difference in
+ * throughput and p99 latency between audited and unaudited runs is given
+ * with a 95% confidence interval over the rounds.
+ */
+
+#include <sys/param.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include <bsm/libbsm.h>
+#include <security/audit/audit_ioctl.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define	MAXTHREADS	256
+/* Time limit for the NFS server to answer the readiness probe */
+#define	PROBE_TIMEOUT_MS	10000
+#define	MAXROUNDS	100
+/* Longest the auditpipe drainer waits before checking it should stop */
+#define	DRAIN_SLICE_MS	100
+
+enum bench_op {
+	OP_GETATTR,
+	OP_LOOKUP,
+	OP_ACCESS,
+	OP_READ,
+	OP_WRITE,
+	OP_CREATE,
+	OP_REMOVE,
+	OP_READDIR,
+	OP_FSSTAT,
+	NOPS
+};
+
+static struct {
+	const char	*name;
+	int		event;
+	u_long		weight;		/* share of the mix */
+} ops[NOPS] = {
+	[OP_GETATTR] = { "getattr", AUE_NFS3RPC_GETATTR, 4 },
+	[OP_LOOKUP] = { "lookup", AUE_NFS3RPC_LOOKUP, 2 },
+	[OP_ACCESS] = { "access", AUE_NFS3RPC_ACCESS, 2 },
+	[OP_READ] = { "read", AUE_NFS3RPC_READ, 2 },
+	[OP_WRITE] = { "write", AUE_NFS3RPC_WRITE, 1 },
+	[OP_CREATE] = { "create", AUE_NFS3RPC_CREATE, 1 },
+	[OP_REMOVE] = { "remove", AUE_NFS3RPC_REMOVE, 1 },
+	[OP_READDIR] = { "readdir", AUE_NFS3RPC_READDIR, 0 },
+	[OP_FSSTAT] = { "fsstat", AUE_NFS3RPC_FSSTAT, 0 },
+};
+
+/*
+ * A thread works on a file of its own, "bench.<id>", which READ and WRITE
+ * go to, and on the files it creates, "bench.<id>.<n>". REMOVE takes out
+ * the oldest of those left, or fails with NFS3ERR_NOENT if none is.
+ */
+struct bench_thread {
+	pthread_t		thread;
+	int			id;
+	struct nfs_pool		*pool;
+	struct nfs_context	*nfs;	/* NULL once discarded */
+	struct nfs_fh3		dirfh;
+	struct nfsfh		*file;	/* open file of the thread */
+	struct nfs_fh3		filefh;	/* its handle */
+	char			name[NAME_MAX];
+	u_int			seed;
+	u_long			created;
+	u_long			removed;
+	char			*buf;
+	bool			failed;
+	uintmax_t		count[NOPS];
+	uintmax_t		errors[NOPS];
+};
+
+/* Throughput and tail latency of a measured run */
+struct bench_result {
+	double		ops;		/* per second */
+	double		p99;		/* microseconds */
+};
+
+/* The auditpipe of the A/B mode and the thread which empties it */
+struct bench_pipe {
+	int		fd;
+	pthread_t	thread;
+	volatile bool	stop;
+	uintmax_t	bytes;
+};
+
+static struct timespec deadline;
+static size_t iosize = 4096;
+static u_long totalweight;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: nfs-audit-bench [-d directory] "
+	    "[-m proc:weight] ... [-s iosize] [-t threads]\n"
+	    "           [-T seconds] [-a rounds [-w seconds]]\n");
+	exit(2);
+}
+
+static bool
+expired(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec > deadline.tv_sec || (now.tv_sec ==
+	    deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec));
+}
+
+static enum bench_op
+pick_op(struct bench_thread *t)
+{
+	u_long pick;
+	int op;
+
+	pick = (u_long)rand_r(&t->seed) % totalweight;
+	for (op = 0; pick >= ops[op].weight; op++)
+		pick -= ops[op].weight;
+	return (op);
+}
+
+/*
+ * Issue one RPC of 'op' on the context of the thread, stamped as submitted
+ * only if it was. The arguments are encoded by the call, so they need not
+ * outlive it.
+ */
+static int
+issue_op(struct bench_thread *t, enum bench_op op,
+    struct au_rpc_data *au_test_data)
+{
+	struct rpc_context *rpc = t->nfs->rpc;
+	char name[NAME_MAX];
+	union {
+		GETATTR3args	getattr;
+		LOOKUP3args	lookup;
+		ACCESS3args	access;
+		READ3args	read;
+		WRITE3args	write;
+		CREATE3args	create;
+		REMOVE3args	remove;
+		READDIR3args	readdir;
+		FSSTAT3args	fsstat;
+	} args;
+
+	memset(&args, 0, sizeof(args));
+	switch (op) {
+	case OP_GETATTR:
+		args.getattr.object = t->filefh;
+		return (AU_RPC_ASYNC(rpc_nfs3_getattr_async, rpc,
+		    nfs_res_close_cb, &args.getattr, au_test_data));
+	case OP_LOOKUP:
+		args.lookup.what.dir = t->dirfh;
+		args.lookup.what.name = t->name;
+		return (AU_RPC_ASYNC(rpc_nfs3_lookup_async, rpc,
+		    nfs_res_close_cb, &args.lookup, au_test_data));
+	case OP_ACCESS:
+		args.access.object = t->filefh;
+		args.access.access = ACCESS3_READ | ACCESS3_MODIFY;
+		return (AU_RPC_ASYNC(rpc_nfs3_access_async, rpc,
+		    nfs_res_close_cb, &args.access, au_test_data));
+	case OP_READ:
+		args.read.file = t->filefh;
+		args.read.count = (uint32_t)iosize;
+		return (AU_RPC_ASYNC(rpc_nfs3_read_async, rpc,
+		    nfs_res_close_cb, &args.read, au_test_data));
+	case OP_WRITE:
+		args.write.file = t->filefh;
+		args.write.count = (uint32_t)iosize;
+		args.write.stable = UNSTABLE;
+		args.write.data.data_len = (u_int)iosize;
+		args.write.data.data_val = t->buf;
+		return (AU_RPC_ASYNC(rpc_nfs3_write_async, rpc,
+		    nfs_res_close_cb, &args.write, au_test_data));
+	case OP_CREATE:
+		snprintf(name, sizeof(name), "%s.%lu", t->name, t->created++);
+		args.create.where.dir = t->dirfh;
+		args.create.where.name = name;
+		args.create.how.mode = GUARDED;
+		args.create.how.createhow3_u.obj_attributes.mode.set_it = 1;
+		args.create.how.createhow3_u.obj_attributes.mode.
+		    set_mode3_u.mode = 0644;
+		return (AU_RPC_ASYNC(rpc_nfs3_create_async, rpc,
+		    nfs_res_close_cb, &args.create, au_test_data));
+	case OP_REMOVE:
+		if (t->removed < t->created)
+			snprintf(name, sizeof(name), "%s.%lu", t->name,
+			    t->removed++);
+		else
+			snprintf(name, sizeof(name), "%s.none", t->name);
+		args.remove.object.dir = t->dirfh;
+		args.remove.object.name = name;
+		return (AU_RPC_ASYNC(rpc_nfs3_remove_async, rpc,
+		    nfs_res_close_cb, &args.remove, au_test_data));
+	case OP_READDIR:
+		args.readdir.dir = t->dirfh;
+		args.readdir.count = 8192;
+		return (AU_RPC_ASYNC(rpc_nfs3_readdir_async, rpc,
+		    nfs_res_close_cb, &args.readdir, au_test_data));
+	case OP_FSSTAT:
+		args.fsstat.fsroot = t->dirfh;
+		return (AU_RPC_ASYNC(rpc_nfs3_fsstat_async, rpc,
+		    nfs_res_close_cb, &args.fsstat, au_test_data));
+	default:
+		return (-1);
+	}
+}
+
+static void *
+bench_run(void *arg)
+{
+	struct bench_thread *t = arg;
+	struct au_rpc_data au_test_data;
+	enum bench_op op;
+	int error, pending;
+
+	while (!expired()) {
+		op = pick_op(t);
+		au_rpc_init(&au_test_data, ops[op].event);
+		error = issue_op(t, op, &au_test_data);
+		if (error != 0 ||
+		    (pending = nfs_wait_rpc(t->nfs, &au_test_data)) == -1) {
+			warnx("thread %d: %s: %s", t->id, ops[op].name,
+			    nfs_get_error(t->nfs));
+			t->failed = true;
+			break;
+		}
+		/* A stalled server fails the run instead of hanging it */
+		if (pending != 0) {
+			warnx("thread %d: %s: no reply in time", t->id,
+			    ops[op].name);
+			nfs_cancel_rpcs(t->nfs, &au_test_data, 1);
+			nfs_pool_discard(t->pool, t->nfs);
+			t->nfs = NULL;
+			t->failed = true;
+			break;
+		}
+		t->count[op]++;
+		if (au_test_data.au_rpc_status != RPC_STATUS_SUCCESS ||
+		    au_test_data.au_rpc_result != NFS3_OK)
+			t->errors[op]++;
+	}
+	return (NULL);
+}
+
+/*
+ * Create the file of the thread and look it up through its context.
+ */
+static void
+bench_prepare(struct bench_thread *t)
+{
+	struct nfs_fh *fh;
+	int fd;
+
+	snprintf(t->name, sizeof(t->name), "bench.%d", t->id);
+	t->seed = (u_int)t->id;
+	if ((t->buf = calloc(1, iosize)) == NULL)
+		err(1, "calloc");
+	if ((fd = open(t->name, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1 ||
+	    pwrite(fd, t->buf, iosize, 0) != (ssize_t)iosize)
+		err(1, "%s", t->name);
+	close(fd);
+	if (nfs_open(t->nfs, t->name, O_RDWR, &t->file) != 0)
+		errx(1, "nfs_open %s: %s", t->name, nfs_get_error(t->nfs));
+	fh = nfs_get_fh(t->file);
+	t->filefh.data.data_len = fh->len;
+	t->filefh.data.data_val = fh->val;
+	t->dirfh.data.data_len = t->nfs->rootfh.len;
+	t->dirfh.data.data_val = t->nfs->rootfh.val;
+}
+
+/*
+ * Undo bench_prepare(), while the context of the thread is still mounted.
+ * The file of a context discarded after a stall has nothing left to be
+ * closed on and is left to exit(3).
+ */
+static void
+bench_clean(struct bench_thread *t)
+{
+	char name[NAME_MAX];
+
+	if (t->nfs != NULL)
+		nfs_close(t->nfs, t->file);
+	for (; t->removed < t->created; t->removed++) {
+		snprintf(name, sizeof(name), "%s.%lu", t->name, t->removed);
+		unlink(name);
+	}
+	unlink(t->name);
+	free(t->buf);
+}
+
+static void
+parse_mix(char *spec, bool *reset)
+{
+	char *name;
+	int i, op;
+
+	name = strsep(&spec, ":");
+	for (op = 0; op < NOPS; op++) {
+		if (strcmp(name, ops[op].name) == 0)
+			break;
+	}
+	if (op == NOPS || spec == NULL)
+		errx(2, "invalid procedure %s", name);
+	/* The first -m replaces the default mix */
+	if (*reset) {
+		for (i = 0; i < NOPS; i++)
+			ops[i].weight = 0;
+		*reset = false;
+	}
+	ops[op].weight = strtoul(spec, NULL, 10);
+}
+
+/*
+ * Run the workload on every thread for 'seconds'. The latencies of the
+ * run are left in the histograms of utils.c. Returns false if a thread
+ * failed.
+ */
+static bool
+bench_workload(struct bench_thread threads[], long nthreads, long seconds,
+    double *secs)
+{
+	struct timespec start;
+	bool failed = false;
+	long i;
+
+	rpc_latency_reset();
+	for (i = 0; i < nthreads; i++) {
+		memset(threads[i].count, 0, sizeof(threads[i].count));
+		memset(threads[i].errors, 0, sizeof(threads[i].errors));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	deadline = start;
+	deadline.tv_sec += seconds;
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i].thread, NULL, bench_run,
+		    &threads[i]) != 0)
+			errx(1, "pthread_create");
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		failed |= threads[i].failed;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	*secs = (deadline.tv_sec - start.tv_sec) +
+	    (deadline.tv_nsec - start.tv_nsec) / 1e9;
+	return (!failed);
+}
+
+static void
+bench_report(struct bench_thread threads[], long nthreads, double secs)
+{
+	struct rpc_latency lat;
+	uintmax_t count, errors, total;
+	long i;
+	int op;
+
+	printf("threads=%ld seconds=%.3f iosize=%zu\n", nthreads, secs,
+	    iosize);
+	printf("%-8s %10s %8s %10s %10s %10s %10s\n", "proc", "ops", "errors",
+	    "ops/s", "p50_us", "p99_us", "p999_us");
+	for (total = 0, op = 0; op < NOPS; op++) {
+		for (count = errors = 0, i = 0; i < nthreads; i++) {
+			count += threads[i].count[op];
+			errors += threads[i].errors[op];
+		}
+		if (count == 0)
+			continue;
+		total += count;
+		memset(&lat, 0, sizeof(lat));
+		rpc_latency_get(ops[op].event, &lat);
+		printf("%-8s %10ju %8ju %10.0f %10.1f %10.1f %10.1f\n",
+		    ops[op].name, count, errors, count / secs, lat.p50 / 1e3,
+		    lat.p99 / 1e3, lat.p999 / 1e3);
+	}
+	printf("%-8s %10ju %8s %10.0f\n", "total", total, "", total / secs);
+}
+
+/*
+ * Keep the auditpipe of the A/B mode from filling up, which would make
+ * the kernel drop records instead of delivering them.
+ */
+static void *
+bench_drain(void *arg)
+{
+	struct bench_pipe *ap = arg;
+	static u_char buf[64 * 1024];
+	struct pollfd pfd;
+	ssize_t len;
+
+	pfd.fd = ap->fd;
+	pfd.events = POLLIN;
+	while (!ap->stop) {
+		if (poll(&pfd, 1, DRAIN_SLICE_MS) <= 0)
+			continue;
+		if ((len = read(ap->fd, buf, sizeof(buf))) > 0)
+			ap->bytes += (uintmax_t)len;
+	}
+	return (NULL);
+}
+
+static void
+pipe_open(struct bench_pipe *ap)
+{
+	int mode = AUDITPIPE_PRESELECT_MODE_LOCAL, qlimit;
+
+	memset(ap, 0, sizeof(*ap));
+	if ((ap->fd = open("/dev/auditpipe", O_RDONLY)) == -1)
+		err(1, "/dev/auditpipe");
+	if (ioctl(ap->fd, AUDITPIPE_SET_PRESELECT_MODE, &mode) == -1 ||
+	    ioctl(ap->fd, AUDITPIPE_GET_QLIMIT_MAX, &qlimit) == -1 ||
+	    ioctl(ap->fd, AUDITPIPE_SET_QLIMIT, &qlimit) == -1)
+		err(1, "auditpipe preselection");
+	if (pthread_create(&ap->thread, NULL, bench_drain, ap) != 0)
+		errx(1, "pthread_create");
+}
+
+static void
+pipe_close(struct bench_pipe *ap)
+{
+	ap->stop = true;
+	pthread_join(ap->thread, NULL);
+	close(ap->fd);
+}
+
+/*
+ * Preselect the events of audit class 'name' on the pipe, as setup() does
+ * for the tests.
+ */
+static void
+pipe_select(struct bench_pipe *ap, const char *name)
+{
+	au_class_ent_t *class;
+	au_mask_t fmask;
+
+	if ((class = getauclassnam(name)) == NULL)
+		errx(1, "no audit class %s", name);
+	fmask.am_success = class->ac_class;
+	fmask.am_failure = class->ac_class;
+	if (ioctl(ap->fd, AUDITPIPE_SET_PRESELECT_FLAGS, &fmask) == -1 ||
+	    ioctl(ap->fd, AUDITPIPE_SET_PRESELECT_NAFLAGS, &fmask) == -1)
+		err(1, "auditpipe preselection flags");
+}
+
+static uint64_t
+pipe_drops(const struct bench_pipe *ap)
+{
+	uint64_t drops;
+
+	if (ioctl(ap->fd, AUDITPIPE_GET_DROPS, &drops) == -1)
+		err(1, "AUDITPIPE_GET_DROPS");
+	return (drops);
+}
+
+/*
+ * Alternate audited and unaudited runs for 'rounds' and report how much
+ * audit changes the throughput and the p99 latency, relative to the run
+ * without it in the same round.
+ */
+static bool
+bench_ab(struct bench_thread threads[], long nthreads, long seconds,
+    long warmup, int rounds)
+{
+	static const char *const classes[] = { "no", "nfs" };
+	struct bench_result res[MAXROUNDS][2];
+	struct rpc_latency lat;
+	struct bench_pipe ap;
+	double dops[MAXROUNDS], dp99[MAXROUNDS];
+	double mean, half, secs, sumops, sump99;
+	uint64_t drops;
+	uintmax_t total;
+	long i;
+	int arm, k, op, r;
+
+	pipe_open(&ap);
+	drops = 0;
+	for (r = 0; r < rounds; r++) {
+		for (k = 0; k < 2; k++) {
+			/* "no" first in even rounds, "nfs" first in odd ones */
+			arm = k ^ (r & 1);
+			pipe_select(&ap, classes[arm]);
+			if (!bench_workload(threads, nthreads, warmup, &secs))
+				goto fail;
+			if (arm == 1)
+				drops -= pipe_drops(&ap);
+			if (!bench_workload(threads, nthreads, seconds, &secs))
+				goto fail;
+			if (arm == 1)
+				drops += pipe_drops(&ap);
+
+			for (total = 0, op = 0; op < NOPS; op++) {
+				for (i = 0; i < nthreads; i++)
+					total += threads[i].count[op];
+			}
+			memset(&lat, 0, sizeof(lat));
+			rpc_latency_get(RPC_LATENCY_ANY, &lat);
+			res[r][arm].ops = total / secs;
+			res[r][arm].p99 = lat.p99 / 1e3;
+			printf("round=%d audit=%s ops/s=%.0f p99_us=%.1f\n", r,
+			    classes[arm], res[r][arm].ops, res[r][arm].p99);
+		}
+		dops[r] = 100 * (res[r][1].ops / res[r][0].ops - 1);
+		dp99[r] = 100 * (res[r][1].p99 / res[r][0].p99 - 1);
+	}
+	pipe_close(&ap);
+
+	for (arm = 0; arm < 2; arm++) {
+		for (sumops = sump99 = 0, r = 0; r < rounds; r++) {
+			sumops += res[r][arm].ops;
+			sump99 += res[r][arm].p99;
+		}
+		printf("audit=%s mean_ops/s=%.0f mean_p99_us=%.1f\n",
+		    classes[arm], sumops / rounds, sump99 / rounds);
+	}
+	mean_confidence(dops, rounds, &mean, &half);
+	printf("throughput_delta=%+.2f%% +/- %.2f%%\n", mean, half);
+	mean_confidence(dp99, rounds, &mean, &half);
+	printf("p99_delta=%+.2f%% +/- %.2f%%\n", mean, half);
+	printf("audit_bytes=%ju audit_drops=%ju\n", ap.bytes,
+	    (uintmax_t)drops);
+	if (drops != 0)
+		warnx("auditpipe dropped records, audit cost is understated");
+	return (true);
+fail:
+	pipe_close(&ap);
+	return (false);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct bench_thread threads[MAXTHREADS];
+	struct nfs_pool *pool;
+	char dir[PATH_MAX];
+	const char *workdir = ".";
+	long nthreads = 1, seconds = 10, warmup = 1, rounds = 0;
+	bool reset = true, ok, fixture;
+	double secs;
+	int ch, i, op;
+
+	while ((ch = getopt(argc, argv, "a:d:m:s:t:T:w:")) != -1) {
+		switch (ch) {
+		case 'a':
+			rounds = strtol(optarg, NULL, 10);
+			if (rounds < 1 || rounds > MAXROUNDS)
+				errx(2, "invalid round count %s", optarg);
+			break;
+		case 'd':
+			workdir = optarg;
+			break;
+		case 'm':
+			parse_mix(optarg, &reset);
+			break;
+		case 's':
+			iosize = strtoul(optarg, NULL, 10);
+			if (iosize == 0 || iosize > 1024 * 1024)
+				errx(2, "invalid I/O size %s", optarg);
+			break;
+		case 't':
+			nthreads = strtol(optarg, NULL, 10);
+			if (nthreads < 1 || nthreads > MAXTHREADS)
+				errx(2, "invalid thread count %s", optarg);
+			break;
+		case 'T':
+			if ((seconds = strtol(optarg, NULL, 10)) < 1)
+				errx(2, "invalid duration %s", optarg);
+			break;
+		case 'w':
+			if ((warmup = strtol(optarg, NULL, 10)) < 0)
+				errx(2, "invalid warm-up %s", optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc != optind)
+		usage();
+	for (op = 0; op < NOPS; op++)
+		totalweight += ops[op].weight;
+	if (totalweight == 0)
+		errx(2, "empty procedure mix");
+
+	/* The fixture exports a directory of the bench's own */
+	fixture = getenv("NFSAUDIT_STANDIN") == NULL;
+	if (rounds != 0 && !fixture)
+		errx(2, "the A/B mode needs kernel audit");
+	if (fixture && fixture_mkdir(dir, sizeof(dir)) != 0)
+		errx(1, "unable to make a directory of the fixture");
+	if (!fixture)
+		strlcpy(dir, workdir, sizeof(dir));
+	if (chdir(dir) == -1 || getcwd(dir, sizeof(dir)) == NULL)
+		err(1, "%s", dir);
+	if (fixture) {
+		if (fixture_acquire(false) != 0) {
+			fixture_rmdir(dir);
+			errx(1, "unable to bring up the NFS server fixture");
+		}
+		if (nfs_probe(false, PROBE_TIMEOUT_MS) < 0) {
+			fixture_release();
+			fixture_rmdir(dir);
+			errx(1, "NFS server is not ready");
+		}
+	}
+	/* The A/B mode needs auditing on, which auditd(8) turns on */
+	if (rounds != 0 && fixture_acquire_audit() < 0) {
+		fixture_release();
+		fixture_rmdir(dir);
+		errx(1, "unable to enable auditing");
+	}
+
+	if ((pool = nfs_pool_create(dir, NFS_V3, (u_int)nthreads)) == NULL)
+		err(1, "nfs_pool_create");
+	for (i = 0; i < nthreads; i++) {
+		threads[i].id = i;
+		threads[i].pool = pool;
+		if ((threads[i].nfs = nfs_pool_get(pool)) == NULL)
+			errx(1, "unable to mount %s", dir);
+		bench_prepare(&threads[i]);
+	}
+
+	if (rounds != 0)
+		ok = bench_ab(threads, nthreads, seconds, warmup, (int)rounds);
+	else if ((ok = bench_workload(threads, nthreads, seconds, &secs)))
+		bench_report(threads, nthreads, secs);
+
+	for (i = 0; i < nthreads; i++) {
+		bench_clean(&threads[i]);
+		if (threads[i].nfs != NULL)
+			nfs_pool_put(pool, threads[i].nfs);
+	}
+	nfs_pool_destroy(pool);
+	if (fixture)
+		fixture_rmdir(dir);
+	if (rounds != 0)
+		fixture_release();
+	if (fixture)
+		fixture_release();
+	return (!ok);
+}
@@ -0,0 +1,1542 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Userspace stand-in for the NFS server of the test host. It serves the
+ * MOUNT and NFSv3 programs on one TCP port of 127.0.0.1, backed by the local
+ * file system, and writes a BSM record for every NFSv3 call it handles, with
+ * the AUE_NFS3RPC_* event of the procedure, into a FIFO. When NFSAUDIT_STANDIN
+ * names the directory of the stand-in, tc_body_init() mounts from it and
+ * setup() reads the FIFO in place of /dev/auditpipe, so that the NFSv3 tests
+ * run without kernel NFS or audit.
+ *
+ * NFSv4 is not served: its COMPOUND procedure, and the session setup of an
+ * NFSv4 mount, are a follow-up, see Design. tc_body_init() skips the NFSv4
+ * tests against the stand-in until then.
+ */
+
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <bsm/audit.h>
+#include <bsm/libbsm.h>
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audit_record.h"
+#include "utils.h"
+#include "compat.h"
+
+/* Files the stand-in creates in its directory */
+#define	AUDIT_FIFO	"audit"
+#define	PORT_FILE	"port"
+#define	DROPS_FILE	"drops"
+/* File a test creates in it to stall the replies, see reply_stall() */
+#define	STALL_FILE	"stall"
+
+#define	MAXCLIENTS	64
+/* Largest READ or WRITE transfer the stand-in advertises */
+#define	MAXIO		(1024 * 1024)
+/* Largest READDIR reply, whatever the client asks for */
+#define	MAXDIRENTS	1024
+
+/*
+ * A file handle is the index of the path in the handle table, along with
+ * the device and inode of the file it was made for. It goes stale once the
+ * path refers to another file, or to none.
+ */
+struct fh_data {
+	uint32_t	index;
+	uint32_t	dev;
+	uint64_t	ino;
+};
+
+struct handle {
+	char	*path;
+	dev_t	dev;
+	ino_t	ino;
+};
+
+static struct handle *handles;
+static size_t nhandles, maxhandles;
+
+static char root[PATH_MAX];		/* the exported directory */
+static char dropsfile[PATH_MAX];	/* count of the records dropped */
+static char stallfile[PATH_MAX];
+static int auditfd = -1;		/* write side of the audit FIFO */
+static uintmax_t records, drops;
+static volatile sig_atomic_t done;
+
+static const char writeverf[NFS3_WRITEVERFSIZE] = "standin";
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: nfs-audit-standin [-p port] -d directory "
+	    "-r root\n");
+	exit(2);
+}
+
+static uint32_t
+get32(const u_char *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+/*
+ * The uid and gid of the AUTH_UNIX credential of call, nobody otherwise.
+ */
+static void
+call_cred(const struct rpc_msg *call, uid_t *uid, gid_t *gid)
+{
+	const struct opaque_auth *cred = &call->body.cbody.cred;
+	const u_char *p = (const u_char *)cred->oa_base;
+	size_t off;
+
+	*uid = 65534;
+	*gid = 65534;
+	if (cred->oa_flavor != AUTH_UNIX || cred->oa_length < 8)
+		return;
+	/* stamp, machine name padded to 4 bytes, uid, gid */
+	off = 8 + ((get32(p + 4) + 3) & ~(size_t)3);
+	if (off + 8 > cred->oa_length)
+		return;
+	*uid = get32(p + off);
+	*gid = get32(p + off + 4);
+}
+
+/*
+ * Replace the file path with one holding value, so that readers never see
+ * it half written.
+ */
+static int
+put_count(const char *path, uintmax_t value)
+{
+	char tmp[PATH_MAX];
+	FILE *fp;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if ((fp = fopen(tmp, "w")) == NULL)
+		return (-1);
+	fprintf(fp, "%ju\n", value);
+	if (fclose(fp) != 0 || rename(tmp, path) == -1) {
+		unlink(tmp);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Hold the reply to an NFSv3 call back for as many ms as STALL_FILE holds,
+ * if it exists, like a server which stalls. The tests create it to check
+ * latencies and deadlines. Nothing else is served meanwhile.
+ */
+static void
+reply_stall(void)
+{
+	struct timespec ts;
+	FILE *fp;
+	long ms;
+
+	if ((fp = fopen(stallfile, "r")) == NULL)
+		return;
+	if (fscanf(fp, "%ld", &ms) == 1 && ms > 0) {
+		ts.tv_sec = ms / 1000;
+		ts.tv_nsec = ms % 1000 * 1000000;
+		nanosleep(&ts, NULL);
+	}
+	fclose(fp);
+}
+
+/*
+ * Write the record of an NFSv3 call to the audit FIFO, see au_rec_build().
+ * The FIFO is never waited on. A record which does not fit is dropped and
+ * counted in DROPS_FILE, the AUDITPIPE_GET_DROPS of the stand-in. Every
+ * call is replied to right after, so the stall is taken here first.
+ */
+static void
+audit_emit(const struct rpc_msg *call, int event, int error,
+    const char *path1, const char *path2)
+{
+	static u_char buf[MAX_AUDIT_RECORD_SIZE];
+	size_t len;
+	uid_t uid;
+	gid_t gid;
+
+	reply_stall();
+	call_cred(call, &uid, &gid);
+	len = sizeof(buf);
+	if (au_rec_build(buf, &len, event, uid, gid, error, path1,
+	    path2) != 0 || write(auditfd, buf, len) != (ssize_t)len) {
+		if (put_count(dropsfile, ++drops) == -1)
+			warn("%s", dropsfile);
+		return;
+	}
+	records++;
+}
+
+static nfsstat3
+nfsstat(int error)
+{
+	switch (error) {
+	case 0:
+		return (NFS3_OK);
+	case EPERM:
+		return (NFS3ERR_PERM);
+	case ENOENT:
+		return (NFS3ERR_NOENT);
+	case ENXIO:
+		return (NFS3ERR_NXIO);
+	case EACCES:
+		return (NFS3ERR_ACCES);
+	case EEXIST:
+		return (NFS3ERR_EXIST);
+	case EXDEV:
+		return (NFS3ERR_XDEV);
+	case ENODEV:
+		return (NFS3ERR_NODEV);
+	case ENOTDIR:
+		return (NFS3ERR_NOTDIR);
+	case EISDIR:
+		return (NFS3ERR_ISDIR);
+	case EINVAL:
+		return (NFS3ERR_INVAL);
+	case EFBIG:
+		return (NFS3ERR_FBIG);
+	case ENOSPC:
+		return (NFS3ERR_NOSPC);
+	case EROFS:
+		return (NFS3ERR_ROFS);
+	case EMLINK:
+		return (NFS3ERR_MLINK);
+	case ENAMETOOLONG:
+		return (NFS3ERR_NAMETOOLONG);
+	case ENOTEMPTY:
+		return (NFS3ERR_NOTEMPTY);
+	case EDQUOT:
+		return (NFS3ERR_DQUOT);
+	case ESTALE:
+		return (NFS3ERR_STALE);
+	case EBADF:
+		return (NFS3ERR_BADHANDLE);
+	case EOPNOTSUPP:
+		return (NFS3ERR_NOTSUPP);
+	default:
+		return (NFS3ERR_IO);
+	}
+}
+
+/*
+ * Make the handle of path, which is the file sb describes, into fh. buf
+ * holds the handle and must outlive fh.
+ */
+static int
+fh_make(const char *path, const struct stat *sb, struct fh_data *buf,
+    nfs_fh3 *fh)
+{
+	struct handle *h;
+	size_t i;
+
+	for (i = 0; i < nhandles; i++) {
+		if (strcmp(handles[i].path, path) == 0)
+			break;
+	}
+	if (i == nhandles) {
+		if (nhandles == maxhandles) {
+			maxhandles = maxhandles == 0 ? 64 : maxhandles * 2;
+			h = reallocarray(handles, maxhandles,
+			    sizeof(*handles));
+			if (h == NULL)
+				return (ENOMEM);
+			handles = h;
+		}
+		if ((handles[i].path = strdup(path)) == NULL)
+			return (ENOMEM);
+		nhandles++;
+	}
+	handles[i].dev = sb->st_dev;
+	handles[i].ino = sb->st_ino;
+
+	buf->index = (uint32_t)i;
+	buf->dev = (uint32_t)sb->st_dev;
+	buf->ino = (uint64_t)sb->st_ino;
+	fh->data.data_len = sizeof(*buf);
+	fh->data.data_val = (char *)buf;
+	return (0);
+}
+
+/*
+ * Path of the file fh refers to, and its attributes in sb.
+ */
+static int
+fh_resolve(const nfs_fh3 *fh, const char **path, struct stat *sb)
+{
+	struct fh_data data;
+	const struct handle *h;
+
+	if (fh->data.data_len != sizeof(data))
+		return (EBADF);
+	memcpy(&data, fh->data.data_val, sizeof(data));
+	if (data.index >= nhandles)
+		return (EBADF);
+	h = &handles[data.index];
+	if (lstat(h->path, sb) == -1 || sb->st_dev != h->dev ||
+	    sb->st_ino != h->ino || (uint32_t)h->dev != data.dev ||
+	    (uint64_t)h->ino != data.ino)
+		return (ESTALE);
+	*path = h->path;
+	return (0);
+}
+
+/*
+ * Path of name in directory dir, into buf. Lookups never go above root.
+ */
+static int
+child_path(const char *dir, const char *name, char *buf, size_t size)
+{
+	const char *slash;
+
+	if (name == NULL || name[0] == '\0' || strchr(name, '/') != NULL)
+		return (EINVAL);
+	if (strlen(name) > NAME_MAX)
+		return (ENAMETOOLONG);
+	if (strcmp(name, ".") == 0) {
+		name = NULL;
+	} else if (strcmp(name, "..") == 0) {
+		if (strcmp(dir, root) == 0) {
+			name = NULL;
+		} else {
+			slash = strrchr(dir, '/');
+			if ((size_t)(slash - dir) >= size)
+				return (ENAMETOOLONG);
+			snprintf(buf, size, "%.*s", slash == dir ? 1 :
+			    (int)(slash - dir), dir);
+			return (0);
+		}
+	}
+	if (name == NULL) {
+		if ((size_t)snprintf(buf, size, "%s", dir) >= size)
+			return (ENAMETOOLONG);
+		return (0);
+	}
+	if ((size_t)snprintf(buf, size, "%s%s%s", dir,
+	    strcmp(dir, "/") == 0 ? "" : "/", name) >= size)
+		return (ENAMETOOLONG);
+	return (0);
+}
+
+/*
+ * Resolve the directory of diropargs and the path of its name.
+ */
+static int
+dirop_resolve(const diropargs3 *dirop, const char **dir, char *buf,
+    size_t size)
+{
+	struct stat sb;
+	int error;
+
+	if ((error = fh_resolve(&dirop->dir, dir, &sb)) != 0)
+		return (error);
+	if (!S_ISDIR(sb.st_mode))
+		return (ENOTDIR);
+	return (child_path(*dir, dirop->name, buf, size));
+}
+
+static void
+nfstime(nfstime3 *t, const struct timespec *ts)
+{
+	t->seconds = (uint32_t)ts->tv_sec;
+	t->nseconds = (uint32_t)ts->tv_nsec;
+}
+
+static void
+fattr(fattr3 *fa, const struct stat *sb)
+{
+	switch (sb->st_mode & S_IFMT) {
+	case S_IFDIR:
+		fa->type = NF3DIR;
+		break;
+	case S_IFBLK:
+		fa->type = NF3BLK;
+		break;
+	case S_IFCHR:
+		fa->type = NF3CHR;
+		break;
+	case S_IFLNK:
+		fa->type = NF3LNK;
+		break;
+	case S_IFSOCK:
+		fa->type = NF3SOCK;
+		break;
+	case S_IFIFO:
+		fa->type = NF3FIFO;
+		break;
+	default:
+		fa->type = NF3REG;
+		break;
+	}
+	fa->mode = sb->st_mode & 07777;
+	fa->nlink = (uint32_t)sb->st_nlink;
+	fa->uid = sb->st_uid;
+	fa->gid = sb->st_gid;
+	fa->size = (uint64_t)sb->st_size;
+	fa->used = (uint64_t)sb->st_blocks * 512;
+	fa->rdev.specdata1 = major(sb->st_rdev);
+	fa->rdev.specdata2 = minor(sb->st_rdev);
+	fa->fsid = (uint64_t)sb->st_dev;
+	fa->fileid = (uint64_t)sb->st_ino;
+	nfstime(&fa->atime, &sb->st_atim);
+	nfstime(&fa->mtime, &sb->st_mtim);
+	nfstime(&fa->ctime, &sb->st_ctim);
+}
+
+static void
+post_op_attr_of(post_op_attr *attr, const char *path)
+{
+	struct stat sb;
+
+	attr->attributes_follow = path != NULL && lstat(path, &sb) == 0;
+	if (attr->attributes_follow)
+		fattr(&attr->post_op_attr_u.attributes, &sb);
+}
+
+static void
+post_op_fh_of(post_op_fh3 *pfh, const char *path, struct fh_data *buf)
+{
+	struct stat sb;
+
+	pfh->handle_follows = lstat(path, &sb) == 0 &&
+	    fh_make(path, &sb, buf, &pfh->post_op_fh3_u.handle) == 0;
+}
+
+/*
+ * Apply the attributes of sa that are set to path.
+ */
+static int
+sattr_apply(const char *path, const sattr3 *sa)
+{
+	struct timespec ts[2];
+	struct stat sb;
+
+	if (sa->mode.set_it && lstat(path, &sb) == 0 && !S_ISLNK(sb.st_mode) &&
+	    chmod(path, sa->mode.set_mode3_u.mode & 07777) == -1)
+		return (errno);
+	if ((sa->uid.set_it || sa->gid.set_it) && lchown(path,
+	    sa->uid.set_it ? sa->uid.set_uid3_u.uid : (uid_t)-1,
+	    sa->gid.set_it ? sa->gid.set_gid3_u.gid : (gid_t)-1) == -1)
+		return (errno);
+	if (sa->size.set_it &&
+	    truncate(path, (off_t)sa->size.set_size3_u.size) == -1)
+		return (errno);
+	if (sa->atime.set_it == DONT_CHANGE && sa->mtime.set_it == DONT_CHANGE)
+		return (0);
+	ts[0].tv_nsec = ts[1].tv_nsec = UTIME_OMIT;
+	ts[0].tv_sec = ts[1].tv_sec = 0;
+	if (sa->atime.set_it == SET_TO_SERVER_TIME)
+		ts[0].tv_nsec = UTIME_NOW;
+	else if (sa->atime.set_it == SET_TO_CLIENT_TIME) {
+		ts[0].tv_sec = sa->atime.set_atime_u.atime.seconds;
+		ts[0].tv_nsec = sa->atime.set_atime_u.atime.nseconds;
+	}
+	if (sa->mtime.set_it == SET_TO_SERVER_TIME)
+		ts[1].tv_nsec = UTIME_NOW;
+	else if (sa->mtime.set_it == SET_TO_CLIENT_TIME) {
+		ts[1].tv_sec = sa->mtime.set_mtime_u.mtime.seconds;
+		ts[1].tv_nsec = sa->mtime.set_mtime_u.mtime.nseconds;
+	}
+	if (utimensat(AT_FDCWD, path, ts, AT_SYMLINK_NOFOLLOW) == -1)
+		return (errno);
+	return (0);
+}
+
+static mode_t
+sattr_mode(const sattr3 *sa, mode_t mode)
+{
+	return (sa->mode.set_it ? sa->mode.set_mode3_u.mode & 07777 : mode);
+}
+
+/*
+ * MOUNT program
+ */
+static int
+mount3_null_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	return (rpc_send_reply(rpc, call, NULL, (zdrproc_t)zdr_void, 0));
+}
+
+static int
+mount3_mnt_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	dirpath *dir = call->body.cbody.args;
+	static int flavors[] = { AUTH_UNIX };
+	struct fh_data buf;
+	char path[PATH_MAX];
+	mountres3 res;
+	struct stat sb;
+	nfs_fh3 fh;
+	size_t rootlen;
+
+	memset(&res, 0, sizeof(res));
+	rootlen = strlen(root);
+	if (realpath(*dir, path) == NULL)
+		res.fhs_status = MNT3ERR_NOENT;
+	else if (strcmp(root, "/") != 0 && (strncmp(path, root, rootlen) != 0 ||
+	    (path[rootlen] != '\0' && path[rootlen] != '/')))
+		res.fhs_status = MNT3ERR_ACCES;
+	else if (stat(path, &sb) == -1 || !S_ISDIR(sb.st_mode))
+		res.fhs_status = MNT3ERR_NOTDIR;
+	else if (fh_make(path, &sb, &buf, &fh) != 0)
+		res.fhs_status = MNT3ERR_SERVERFAULT;
+	else {
+		res.fhs_status = MNT3_OK;
+		res.mountres3_u.mountinfo.fhandle.fhandle3_len =
+		    fh.data.data_len;
+		res.mountres3_u.mountinfo.fhandle.fhandle3_val =
+		    fh.data.data_val;
+		res.mountres3_u.mountinfo.auth_flavors.auth_flavors_len =
+		    nitems(flavors);
+		res.mountres3_u.mountinfo.auth_flavors.auth_flavors_val =
+		    flavors;
+	}
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_mountres3,
+	    sizeof(res)));
+}
+
+static int
+mount3_umnt_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	return (rpc_send_reply(rpc, call, NULL, (zdrproc_t)zdr_void, 0));
+}
+
+static int
+mount3_export_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	struct exportnode export;
+	exports list;
+
+	memset(&export, 0, sizeof(export));
+	export.ex_dir = root;
+	list = &export;
+	return (rpc_send_reply(rpc, call, &list, (zdrproc_t)zdr_exports,
+	    sizeof(list)));
+}
+
+static struct service_proc mount3_procs[] = {
+	{ MOUNT3_NULL, mount3_null_proc, (zdrproc_t)zdr_void, 0, NULL },
+	{ MOUNT3_MNT, mount3_mnt_proc, (zdrproc_t)zdr_dirpath,
+	    sizeof(dirpath), NULL },
+	{ MOUNT3_UMNT, mount3_umnt_proc, (zdrproc_t)zdr_dirpath,
+	    sizeof(dirpath), NULL },
+	{ MOUNT3_UMNTALL, mount3_umnt_proc, (zdrproc_t)zdr_void, 0, NULL },
+	{ MOUNT3_EXPORT, mount3_export_proc, (zdrproc_t)zdr_void, 0, NULL },
+};
+
+/*
+ * NFSv3 program, each procedure audited with the event of the kernel NFS
+ * server.
+ */
+static int
+nfs3_null_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	return (rpc_send_reply(rpc, call, NULL, (zdrproc_t)zdr_void, 0));
+}
+
+static int
+nfs3_getattr_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	GETATTR3args *args = call->body.cbody.args;
+	const char *path = NULL;
+	GETATTR3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	if ((error = fh_resolve(&args->object, &path, &sb)) == 0)
+		fattr(&res.GETATTR3res_u.resok.obj_attributes, &sb);
+	res.status = nfsstat(error);
+	audit_emit(call, AUE_NFS3RPC_GETATTR, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_GETATTR3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_setattr_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	SETATTR3args *args = call->body.cbody.args;
+	const char *path = NULL;
+	SETATTR3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	if ((error = fh_resolve(&args->object, &path, &sb)) == 0) {
+		if (args->guard.check &&
+		    (uint32_t)sb.st_ctim.tv_sec !=
+		    args->guard.sattrguard3_u.obj_ctime.seconds)
+			res.status = NFS3ERR_NOT_SYNC;
+		else
+			error = sattr_apply(path, &args->new_attributes);
+	}
+	if (res.status == NFS3_OK)
+		res.status = nfsstat(error);
+	else
+		error = EINVAL;
+	post_op_attr_of(&res.SETATTR3res_u.resok.obj_wcc.after, path);
+	audit_emit(call, AUE_NFS3RPC_SETATTR, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_SETATTR3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_lookup_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	LOOKUP3args *args = call->body.cbody.args;
+	LOOKUP3resok *ok;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	struct fh_data buf;
+	LOOKUP3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.LOOKUP3res_u.resok;
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->what, &dir, path,
+	    sizeof(path))) == 0) {
+		if (lstat(path, &sb) == -1)
+			error = errno;
+		else
+			error = fh_make(path, &sb, &buf, &ok->object);
+	}
+	res.status = nfsstat(error);
+	if (error == 0) {
+		post_op_attr_of(&ok->obj_attributes, path);
+		post_op_attr_of(&ok->dir_attributes, dir);
+	} else
+		post_op_attr_of(&res.LOOKUP3res_u.resfail.dir_attributes, dir);
+	audit_emit(call, AUE_NFS3RPC_LOOKUP, error,
+	    path[0] != '\0' ? path : dir, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_LOOKUP3res,
+	    sizeof(res)));
+}
+
+/*
+ * The rights among those asked for that the stand-in itself has on path.
+ * Every call is served as the user of the stand-in, whatever its
+ * credential.
+ */
+static uint32_t
+access_rights(const char *path, const struct stat *sb, uint32_t asked)
+{
+	uint32_t granted = 0;
+
+	if (access(path, R_OK) == 0)
+		granted |= ACCESS3_READ;
+	if (access(path, W_OK) == 0) {
+		granted |= ACCESS3_MODIFY | ACCESS3_EXTEND;
+		if (S_ISDIR(sb->st_mode))
+			granted |= ACCESS3_DELETE;
+	}
+	if (access(path, X_OK) == 0)
+		granted |= S_ISDIR(sb->st_mode) ? ACCESS3_LOOKUP :
+		    ACCESS3_EXECUTE;
+	return (granted & asked);
+}
+
+static int
+nfs3_access_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	ACCESS3args *args = call->body.cbody.args;
+	const char *path = NULL;
+	ACCESS3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	if ((error = fh_resolve(&args->object, &path, &sb)) == 0)
+		res.ACCESS3res_u.resok.access = access_rights(path, &sb,
+		    args->access);
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.ACCESS3res_u.resok.obj_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_ACCESS, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_ACCESS3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_readlink_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	READLINK3args *args = call->body.cbody.args;
+	const char *path = NULL;
+	char target[PATH_MAX];
+	READLINK3res res;
+	struct stat sb;
+	ssize_t len;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	if ((error = fh_resolve(&args->symlink, &path, &sb)) == 0) {
+		if (!S_ISLNK(sb.st_mode))
+			error = EINVAL;
+		else if ((len = readlink(path, target,
+		    sizeof(target) - 1)) == -1)
+			error = errno;
+		else {
+			target[len] = '\0';
+			res.READLINK3res_u.resok.data = target;
+		}
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.READLINK3res_u.resok.symlink_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_READLINK, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_READLINK3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_read_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	READ3args *args = call->body.cbody.args;
+	READ3resok *ok;
+	const char *path = NULL;
+	char *data = NULL;
+	READ3res res;
+	struct stat sb;
+	ssize_t len;
+	int error, fd, ret;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.READ3res_u.resok;
+	if ((error = fh_resolve(&args->file, &path, &sb)) == 0) {
+		if (S_ISDIR(sb.st_mode))
+			error = EISDIR;
+		else if ((data = malloc(MIN(args->count, MAXIO) + 1)) == NULL)
+			error = ENOMEM;
+		else if ((fd = open(path, O_RDONLY)) == -1)
+			error = errno;
+		else {
+			len = pread(fd, data, MIN(args->count, MAXIO),
+			    (off_t)args->offset);
+			if (len == -1)
+				error = errno;
+			else {
+				ok->count = (uint32_t)len;
+				ok->eof = args->offset + (uint64_t)len >=
+				    (uint64_t)sb.st_size;
+				ok->data.data_len = (u_int)len;
+				ok->data.data_val = data;
+			}
+			close(fd);
+		}
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->file_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_READ, error, path, NULL);
+	ret = rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_READ3res,
+	    sizeof(res));
+	free(data);
+	return (ret);
+}
+
+static int
+nfs3_write_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	WRITE3args *args = call->body.cbody.args;
+	WRITE3resok *ok;
+	const char *path = NULL;
+	WRITE3res res;
+	struct stat sb;
+	ssize_t len;
+	int error, fd;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.WRITE3res_u.resok;
+	if ((error = fh_resolve(&args->file, &path, &sb)) == 0) {
+		if (S_ISDIR(sb.st_mode))
+			error = EISDIR;
+		else if ((fd = open(path, O_WRONLY)) == -1)
+			error = errno;
+		else {
+			len = pwrite(fd, args->data.data_val,
+			    MIN(args->count, args->data.data_len),
+			    (off_t)args->offset);
+			if (len == -1)
+				error = errno;
+			else if (args->stable != UNSTABLE && fsync(fd) == -1)
+				error = errno;
+			else {
+				ok->count = (uint32_t)len;
+				ok->committed = args->stable == UNSTABLE ?
+				    UNSTABLE : FILE_SYNC;
+				memcpy(ok->verf, writeverf, sizeof(ok->verf));
+			}
+			close(fd);
+		}
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->file_wcc.after, path);
+	audit_emit(call, AUE_NFS3RPC_WRITE, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_WRITE3res,
+	    sizeof(res)));
+}
+
+/*
+ * Reply of the procedures which create a file: CREATE, MKDIR, SYMLINK and
+ * MKNOD share the layout of CREATE3res.
+ */
+static void
+create_result(CREATE3res *res, int error, const char *dir, const char *path,
+    struct fh_data *buf)
+{
+	CREATE3resok *ok = &res->CREATE3res_u.resok;
+
+	res->status = nfsstat(error);
+	if (error == 0) {
+		post_op_fh_of(&ok->obj, path, buf);
+		post_op_attr_of(&ok->obj_attributes, path);
+	}
+	post_op_attr_of(&ok->dir_wcc.after, dir);
+}
+
+static int
+nfs3_create_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	CREATE3args *args = call->body.cbody.args;
+	const sattr3 *sa = &args->how.createhow3_u.obj_attributes;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	struct fh_data buf;
+	CREATE3res res;
+	int error, fd, flags;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->where, &dir, path,
+	    sizeof(path))) == 0) {
+		flags = O_WRONLY | O_CREAT;
+		if (args->how.mode != UNCHECKED)
+			flags |= O_EXCL;
+		if ((fd = open(path, flags, args->how.mode == EXCLUSIVE ?
+		    0644 : sattr_mode(sa, 0644))) == -1)
+			error = errno;
+		else {
+			close(fd);
+			if (args->how.mode != EXCLUSIVE)
+				error = sattr_apply(path, sa);
+		}
+	}
+	create_result(&res, error, dir, path, &buf);
+	audit_emit(call, AUE_NFS3RPC_CREATE, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_CREATE3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_mkdir_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	MKDIR3args *args = call->body.cbody.args;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	struct fh_data buf;
+	CREATE3res res;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->where, &dir, path,
+	    sizeof(path))) == 0) {
+		if (mkdir(path, sattr_mode(&args->attributes, 0755)) == -1)
+			error = errno;
+		else
+			error = sattr_apply(path, &args->attributes);
+	}
+	create_result(&res, error, dir, path, &buf);
+	audit_emit(call, AUE_NFS3RPC_MKDIR, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_MKDIR3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_symlink_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	SYMLINK3args *args = call->body.cbody.args;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	struct fh_data buf;
+	CREATE3res res;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->where, &dir, path,
+	    sizeof(path))) == 0 &&
+	    symlink(args->symlink.symlink_data, path) == -1)
+		error = errno;
+	create_result(&res, error, dir, path, &buf);
+	audit_emit(call, AUE_NFS3RPC_SYMLINK, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_SYMLINK3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_mknod_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	MKNOD3args *args = call->body.cbody.args;
+	const devicedata3 *dev;
+	const sattr3 *sa;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	struct fh_data buf;
+	CREATE3res res;
+	mode_t mode;
+	dev_t rdev;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	rdev = 0;
+	switch (args->what.type) {
+	case NF3CHR:
+	case NF3BLK:
+		dev = args->what.type == NF3CHR ?
+		    &args->what.mknoddata3_u.chr_device :
+		    &args->what.mknoddata3_u.blk_device;
+		sa = &dev->dev_attributes;
+		mode = args->what.type == NF3CHR ? S_IFCHR : S_IFBLK;
+		rdev = makedev(dev->spec.specdata1, dev->spec.specdata2);
+		break;
+	case NF3SOCK:
+		sa = &args->what.mknoddata3_u.sock_attributes;
+		mode = S_IFSOCK;
+		break;
+	case NF3FIFO:
+		sa = &args->what.mknoddata3_u.pipe_attributes;
+		mode = S_IFIFO;
+		break;
+	default:
+		sa = NULL;
+		mode = 0;
+		break;
+	}
+	if ((error = dirop_resolve(&args->where, &dir, path,
+	    sizeof(path))) == 0) {
+		if (sa == NULL)
+			error = EINVAL;
+		else if (mknod(path, mode | sattr_mode(sa, 0644), rdev) == -1)
+			error = errno;
+		else
+			error = sattr_apply(path, sa);
+	}
+	create_result(&res, error, dir, path, &buf);
+	if (sa == NULL && res.status == NFS3ERR_INVAL)
+		res.status = NFS3ERR_BADTYPE;
+	audit_emit(call, AUE_NFS3RPC_MKNOD, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_MKNOD3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_remove_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	REMOVE3args *args = call->body.cbody.args;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	REMOVE3res res;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->object, &dir, path,
+	    sizeof(path))) == 0 && unlink(path) == -1)
+		error = errno;
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.REMOVE3res_u.resok.dir_wcc.after, dir);
+	audit_emit(call, AUE_NFS3RPC_REMOVE, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_REMOVE3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_rmdir_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	RMDIR3args *args = call->body.cbody.args;
+	const char *dir = NULL;
+	char path[PATH_MAX];
+	RMDIR3res res;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	path[0] = '\0';
+	if ((error = dirop_resolve(&args->object, &dir, path,
+	    sizeof(path))) == 0 && rmdir(path) == -1)
+		error = errno;
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.RMDIR3res_u.resok.dir_wcc.after, dir);
+	audit_emit(call, AUE_NFS3RPC_RMDIR, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_RMDIR3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_rename_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	RENAME3args *args = call->body.cbody.args;
+	const char *fromdir = NULL, *todir = NULL;
+	char from[PATH_MAX], to[PATH_MAX];
+	RENAME3res res;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	from[0] = to[0] = '\0';
+	if ((error = dirop_resolve(&args->from, &fromdir, from,
+	    sizeof(from))) == 0 &&
+	    (error = dirop_resolve(&args->to, &todir, to, sizeof(to))) == 0 &&
+	    rename(from, to) == -1)
+		error = errno;
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.RENAME3res_u.resok.fromdir_wcc.after, fromdir);
+	post_op_attr_of(&res.RENAME3res_u.resok.todir_wcc.after, todir);
+	audit_emit(call, AUE_NFS3RPC_RENAME, error, from,
+	    to[0] != '\0' ? to : NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_RENAME3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_link_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	LINK3args *args = call->body.cbody.args;
+	const char *path = NULL, *dir = NULL;
+	char link[PATH_MAX];
+	LINK3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	link[0] = '\0';
+	if ((error = fh_resolve(&args->file, &path, &sb)) == 0 &&
+	    (error = dirop_resolve(&args->link, &dir, link,
+	    sizeof(link))) == 0 && linkat(AT_FDCWD, path, AT_FDCWD, link, 0) ==
+	    -1)
+		error = errno;
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.LINK3res_u.resok.file_attributes, path);
+	post_op_attr_of(&res.LINK3res_u.resok.linkdir_wcc.after, dir);
+	audit_emit(call, AUE_NFS3RPC_LINK, error, path,
+	    link[0] != '\0' ? link : NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_LINK3res,
+	    sizeof(res)));
+}
+
+struct entry {
+	uint64_t	ino;
+	char		name[NAME_MAX + 1];
+};
+
+/*
+ * Read the entries of the directory at path from the cookie-th on, at most
+ * max of them. The cookie of an entry is its position plus one.
+ */
+static int
+read_entries(const char *path, cookie3 cookie, size_t max,
+    struct entry **entriesp, size_t *nentries, bool *eof)
+{
+	struct entry *entries;
+	struct dirent *dp;
+	cookie3 pos;
+	DIR *dirp;
+	size_t n;
+
+	if ((dirp = opendir(path)) == NULL)
+		return (errno);
+	if ((entries = calloc(max, sizeof(*entries))) == NULL) {
+		closedir(dirp);
+		return (ENOMEM);
+	}
+	n = 0;
+	pos = 0;
+	*eof = true;
+	while ((dp = readdir(dirp)) != NULL) {
+		if (pos++ < cookie)
+			continue;
+		if (n == max) {
+			*eof = false;
+			break;
+		}
+		entries[n].ino = (uint64_t)dp->d_ino;
+		snprintf(entries[n].name, sizeof(entries[n].name), "%s",
+		    dp->d_name);
+		n++;
+	}
+	closedir(dirp);
+	*entriesp = entries;
+	*nentries = n;
+	return (0);
+}
+
+static int
+nfs3_readdir_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	READDIR3args *args = call->body.cbody.args;
+	READDIR3resok *ok;
+	struct entry *entries = NULL;
+	entry3 *list = NULL;
+	const char *path = NULL;
+	READDIR3res res;
+	struct stat sb;
+	size_t i, n = 0;
+	bool eof;
+	int error, ret;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.READDIR3res_u.resok;
+	if ((error = fh_resolve(&args->dir, &path, &sb)) == 0) {
+		if (!S_ISDIR(sb.st_mode))
+			error = ENOTDIR;
+		else
+			error = read_entries(path, args->cookie,
+			    MIN(MAXDIRENTS, args->count / 32 + 1), &entries,
+			    &n, &eof);
+	}
+	if (error == 0 && n > 0 && (list = calloc(n, sizeof(*list))) == NULL)
+		error = ENOMEM;
+	if (error == 0) {
+		for (i = 0; i < n; i++) {
+			list[i].fileid = (uint64_t)entries[i].ino;
+			list[i].name = entries[i].name;
+			list[i].cookie = args->cookie + i + 1;
+			list[i].nextentry = i + 1 < n ? &list[i + 1] : NULL;
+		}
+		ok->reply.entries = n > 0 ? list : NULL;
+		ok->reply.eof = eof;
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->dir_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_READDIR, error, path, NULL);
+	ret = rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_READDIR3res,
+	    sizeof(res));
+	free(list);
+	free(entries);
+	return (ret);
+}
+
+static int
+nfs3_readdirplus_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	READDIRPLUS3args *args = call->body.cbody.args;
+	READDIRPLUS3resok *ok;
+	struct entry *entries = NULL;
+	entryplus3 *list = NULL;
+	struct fh_data *bufs = NULL;
+	const char *path = NULL;
+	char child[PATH_MAX];
+	READDIRPLUS3res res;
+	struct stat sb;
+	size_t i, n = 0;
+	bool eof;
+	int error, ret;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.READDIRPLUS3res_u.resok;
+	if ((error = fh_resolve(&args->dir, &path, &sb)) == 0) {
+		if (!S_ISDIR(sb.st_mode))
+			error = ENOTDIR;
+		else
+			error = read_entries(path, args->cookie,
+			    MIN(MAXDIRENTS, args->maxcount / 128 + 1),
+			    &entries, &n, &eof);
+	}
+	if (error == 0 && n > 0 &&
+	    ((list = calloc(n, sizeof(*list))) == NULL ||
+	    (bufs = calloc(n, sizeof(*bufs))) == NULL))
+		error = ENOMEM;
+	if (error == 0) {
+		for (i = 0; i < n; i++) {
+			list[i].fileid = (uint64_t)entries[i].ino;
+			list[i].name = entries[i].name;
+			list[i].cookie = args->cookie + i + 1;
+			if (child_path(path, entries[i].name, child,
+			    sizeof(child)) == 0) {
+				post_op_attr_of(&list[i].name_attributes,
+				    child);
+				post_op_fh_of(&list[i].name_handle, child,
+				    &bufs[i]);
+			}
+			list[i].nextentry = i + 1 < n ? &list[i + 1] : NULL;
+		}
+		ok->reply.entries = n > 0 ? list : NULL;
+		ok->reply.eof = eof;
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->dir_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_READDIRPLUS, error, path, NULL);
+	ret = rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_READDIRPLUS3res,
+	    sizeof(res));
+	free(bufs);
+	free(list);
+	free(entries);
+	return (ret);
+}
+
+static int
+nfs3_fsstat_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	FSSTAT3args *args = call->body.cbody.args;
+	FSSTAT3resok *ok;
+	const char *path = NULL;
+	struct statvfs vfs;
+	FSSTAT3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.FSSTAT3res_u.resok;
+	if ((error = fh_resolve(&args->fsroot, &path, &sb)) == 0) {
+		if (statvfs(path, &vfs) == -1)
+			error = errno;
+		else {
+			ok->tbytes = (uint64_t)vfs.f_blocks * vfs.f_frsize;
+			ok->fbytes = (uint64_t)vfs.f_bfree * vfs.f_frsize;
+			ok->abytes = (uint64_t)vfs.f_bavail * vfs.f_frsize;
+			ok->tfiles = vfs.f_files;
+			ok->ffiles = vfs.f_ffree;
+			ok->afiles = vfs.f_favail;
+		}
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->obj_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_FSSTAT, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_FSSTAT3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_fsinfo_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	FSINFO3args *args = call->body.cbody.args;
+	FSINFO3resok *ok;
+	const char *path = NULL;
+	FSINFO3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.FSINFO3res_u.resok;
+	if ((error = fh_resolve(&args->fsroot, &path, &sb)) == 0) {
+		ok->rtmax = ok->rtpref = MAXIO;
+		ok->wtmax = ok->wtpref = MAXIO;
+		ok->rtmult = ok->wtmult = 4096;
+		ok->dtpref = 64 * 1024;
+		ok->maxfilesize = INT64_MAX;
+		ok->time_delta.nseconds = 1;
+		ok->properties = FSF3_LINK | FSF3_SYMLINK | FSF3_HOMOGENEOUS |
+		    FSF3_CANSETTIME;
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->obj_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_FSINFO, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_FSINFO3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_pathconf_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	PATHCONF3args *args = call->body.cbody.args;
+	PATHCONF3resok *ok;
+	const char *path = NULL;
+	PATHCONF3res res;
+	struct stat sb;
+	int error;
+
+	memset(&res, 0, sizeof(res));
+	ok = &res.PATHCONF3res_u.resok;
+	if ((error = fh_resolve(&args->object, &path, &sb)) == 0) {
+		ok->linkmax = (uint32_t)pathconf(path, _PC_LINK_MAX);
+		ok->name_max = (uint32_t)pathconf(path, _PC_NAME_MAX);
+		ok->no_trunc = 1;
+		ok->chown_restricted = 1;
+		ok->case_preserving = 1;
+	}
+	res.status = nfsstat(error);
+	post_op_attr_of(&ok->obj_attributes, path);
+	audit_emit(call, AUE_NFS3RPC_PATHCONF, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_PATHCONF3res,
+	    sizeof(res)));
+}
+
+static int
+nfs3_commit_proc(struct rpc_context *rpc, struct rpc_msg *call,
+    __unused void *opaque)
+{
+	COMMIT3args *args = call->body.cbody.args;
+	const char *path = NULL;
+	COMMIT3res res;
+	struct stat sb;
+	int error, fd;
+
+	memset(&res, 0, sizeof(res));
+	if ((error = fh_resolve(&args->file, &path, &sb)) == 0) {
+		if ((fd = open(path, O_RDONLY)) == -1)
+			error = errno;
+		else {
+			if (fsync(fd) == -1)
+				error = errno;
+			close(fd);
+		}
+	}
+	if (error == 0)
+		memcpy(res.COMMIT3res_u.resok.verf, writeverf,
+		    sizeof(res.COMMIT3res_u.resok.verf));
+	res.status = nfsstat(error);
+	post_op_attr_of(&res.COMMIT3res_u.resok.file_wcc.after, path);
+	audit_emit(call, AUE_NFS3RPC_COMMIT, error, path, NULL);
+	return (rpc_send_reply(rpc, call, &res, (zdrproc_t)zdr_COMMIT3res,
+	    sizeof(res)));
+}
+
+#define	NFS3_PROC(proc, fn, args)					\
+	{ proc, fn, (zdrproc_t)zdr_##args, sizeof(args), NULL }
+
+static struct service_proc nfs3_procs[] = {
+	{ NFS3_NULL, nfs3_null_proc, (zdrproc_t)zdr_void, 0, NULL },
+	NFS3_PROC(NFS3_GETATTR, nfs3_getattr_proc, GETATTR3args),
+	NFS3_PROC(NFS3_SETATTR, nfs3_setattr_proc, SETATTR3args),
+	NFS3_PROC(NFS3_LOOKUP, nfs3_lookup_proc, LOOKUP3args),
+	NFS3_PROC(NFS3_ACCESS, nfs3_access_proc, ACCESS3args),
+	NFS3_PROC(NFS3_READLINK, nfs3_readlink_proc, READLINK3args),
+	NFS3_PROC(NFS3_READ, nfs3_read_proc, READ3args),
+	NFS3_PROC(NFS3_WRITE, nfs3_write_proc, WRITE3args),
+	NFS3_PROC(NFS3_CREATE, nfs3_create_proc, CREATE3args),
+	NFS3_PROC(NFS3_MKDIR, nfs3_mkdir_proc, MKDIR3args),
+	NFS3_PROC(NFS3_SYMLINK, nfs3_symlink_proc, SYMLINK3args),
+	NFS3_PROC(NFS3_MKNOD, nfs3_mknod_proc, MKNOD3args),
+	NFS3_PROC(NFS3_REMOVE, nfs3_remove_proc, REMOVE3args),
+	NFS3_PROC(NFS3_RMDIR, nfs3_rmdir_proc, RMDIR3args),
+	NFS3_PROC(NFS3_RENAME, nfs3_rename_proc, RENAME3args),
+	NFS3_PROC(NFS3_LINK, nfs3_link_proc, LINK3args),
+	NFS3_PROC(NFS3_READDIR, nfs3_readdir_proc, READDIR3args),
+	NFS3_PROC(NFS3_READDIRPLUS, nfs3_readdirplus_proc, READDIRPLUS3args),
+	NFS3_PROC(NFS3_FSSTAT, nfs3_fsstat_proc, FSSTAT3args),
+	NFS3_PROC(NFS3_FSINFO, nfs3_fsinfo_proc, FSINFO3args),
+	NFS3_PROC(NFS3_PATHCONF, nfs3_pathconf_proc, PATHCONF3args),
+	NFS3_PROC(NFS3_COMMIT, nfs3_commit_proc, COMMIT3args),
+};
+
+static void
+on_signal(__unused int sig)
+{
+	done = 1;
+}
+
+/*
+ * Listen on 127.0.0.1 and write the port to the directory of the stand-in
+ * for tc_body_init() to find.
+ */
+static int
+listen_local(const char *dir, int port)
+{
+	struct sockaddr_in sin;
+	socklen_t len;
+	char path[PATH_MAX];
+	int on, s;
+
+	if ((s = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+	on = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons((uint16_t)port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(s, (struct sockaddr *)&sin, sizeof(sin)) == -1)
+		err(1, "bind");
+	if (listen(s, MAXCLIENTS) == -1)
+		err(1, "listen");
+	len = sizeof(sin);
+	if (getsockname(s, (struct sockaddr *)&sin, &len) == -1)
+		err(1, "getsockname");
+
+	snprintf(path, sizeof(path), "%s/%s", dir, PORT_FILE);
+	if (put_count(path, ntohs(sin.sin_port)) == -1)
+		err(1, "%s", path);
+	return (s);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct rpc_context *clients[MAXCLIENTS];
+	struct pollfd pfd[MAXCLIENTS + 1];
+	char fifo[PATH_MAX], portfile[PATH_MAX];
+	const char *dir, *rootdir;
+	int ch, i, n, nclients, port, s;
+
+	dir = NULL;
+	rootdir = NULL;
+	port = 0;
+	while ((ch = getopt(argc, argv, "d:p:r:")) != -1) {
+		switch (ch) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'r':
+			rootdir = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (dir == NULL || rootdir == NULL || argc != optind)
+		usage();
+	/* Whatever root may do, any client of the port could */
+	if (geteuid() == 0)
+		errx(1, "refusing to serve %s as root", rootdir);
+	if (realpath(rootdir, root) == NULL)
+		err(1, "%s", rootdir);
+
+	/*
+	 * The write side of the FIFO stays open so that records survive
+	 * while no test reads them, up to the capacity of the pipe.
+	 */
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+		err(1, "%s", dir);
+	snprintf(fifo, sizeof(fifo), "%s/%s", dir, AUDIT_FIFO);
+	unlink(fifo);
+	if (mkfifo(fifo, 0600) == -1)
+		err(1, "%s", fifo);
+	if ((auditfd = open(fifo, O_RDWR | O_NONBLOCK)) == -1)
+		err(1, "%s", fifo);
+	snprintf(dropsfile, sizeof(dropsfile), "%s/%s", dir, DROPS_FILE);
+	if (put_count(dropsfile, 0) == -1)
+		err(1, "%s", dropsfile);
+	snprintf(stallfile, sizeof(stallfile), "%s/%s", dir, STALL_FILE);
+	unlink(stallfile);
+	s = listen_local(dir, port);
+	snprintf(portfile, sizeof(portfile), "%s/%s", dir, PORT_FILE);
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	nclients = 0;
+	while (!done) {
+		pfd[0].fd = s;
+		pfd[0].events = nclients < MAXCLIENTS ? POLLIN : 0;
+		for (i = 0; i < nclients; i++) {
+			pfd[i + 1].fd = rpc_get_fd(clients[i]);
+			pfd[i + 1].events = rpc_which_events(clients[i]);
+		}
+		if ((n = poll(pfd, nclients + 1, -1)) == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poll");
+		}
+		for (i = nclients - 1; i >= 0; i--) {
+			if (pfd[i + 1].revents == 0 ||
+			    rpc_service(clients[i], pfd[i + 1].revents) >= 0)
+				continue;
+			rpc_destroy_context(clients[i]);
+			clients[i] = clients[--nclients];
+		}
+		if (pfd[0].revents & POLLIN) {
+			int c;
+
+			if ((c = accept(s, NULL, NULL)) == -1)
+				continue;
+			if ((clients[nclients] =
+			    rpc_init_server_context(c)) == NULL) {
+				close(c);
+				continue;
+			}
+			rpc_register_service(clients[nclients], MOUNT_PROGRAM,
+			    MOUNT_V3, mount3_procs, nitems(mount3_procs));
+			rpc_register_service(clients[nclients], NFS_PROGRAM,
+			    NFS_V3, nfs3_procs, nitems(nfs3_procs));
+			nclients++;
+		}
+	}
+
+	while (nclients > 0)
+		rpc_destroy_context(clients[--nclients]);
+	close(s);
+	unlink(portfile);
+	unlink(dropsfile);
+	unlink(stallfile);
+	unlink(fifo);
+	printf("%ju records written, %ju dropped\n", records, drops);
+	return (0);
+}
@@ -0,0 +1,880 @@
+/*-
+ * Copyright 2020 Shivank Garg
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Offline tool for the audit records captured by the NFS audit tests, see
+ * NFSAUDIT_CAPTURE, or written by auditd(8) to the audit trail.
+ */
+
+#include <sys/param.h>
+#include <sys/stat.h>
+
+#include <bsm/libbsm.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audit_record.h"
+#include "compat.h"
+#include "utils.h"
+
+#define	MAXMATCH	64
+
+/* The NFS events of utils.h, as a contiguous range of ids */
+#define	NFS_EVENT_FIRST	AUE_NFS3RPC_GETATTR
+#define	NFS_EVENT_LAST	AUE_NFSV4OP_REMOVEXATTR
+#define	NFS_NEVENTS	(NFS_EVENT_LAST - NFS_EVENT_FIRST + 1)
+#define	NFS_EVENT(e)	((e) >= NFS_EVENT_FIRST && (e) <= NFS_EVENT_LAST)
+
+/* Below that many bytes per thread, a scan is not worth splitting */
+#define	SCAN_MINCHUNK	(8 * 1024 * 1024)
+#define	SCAN_MAXJOBS	64
+
+/* The NFSv3 events, what "generate" emits unless told otherwise */
+#define	NFS3_EVENT_FIRST	AUE_NFS3RPC_GETATTR
+#define	NFS3_EVENT_LAST		AUE_NFS3RPC_COMMIT
+/* Records "generate" buffers before writing them out */
+#define	GEN_BUFSIZE		(64 * 1024)
+/* Longest the generator sleeps between two bursts at a given rate */
+#define	GEN_SLICE_NS		1000000
+
+/* An event "generate" emits, with its share of the records */
+struct gen_event {
+	int	event;
+	u_long	weight;
+};
+
+/* A record selected by a scan, by event and return status */
+struct scan_hit {
+	size_t	offset;
+	int	bucket;		/* 2 * (event - NFS_EVENT_FIRST) + failure */
+};
+
+/*
+ * Part of a trail scanned by one thread. Its bounds are record boundaries
+ * so that every record is counted by exactly one job.
+ */
+struct scan_job {
+	pthread_t	thread;
+	u_char	*buf;		/* the whole mapped trail */
+	size_t	size;
+	size_t	start;
+	size_t	end;
+	const bool	*events;	/* events selected, indexed from first */
+	int	status;		/* AU_MATCH_* status selected */
+	bool	list;		/* keep the records selected in hits */
+	uintmax_t	records;
+	uintmax_t	malformed;
+	uintmax_t	noreturn;	/* selected records with no AUT_RETURN */
+	uintmax_t	counts[NFS_NEVENTS][2];
+	struct scan_hit	*hits;
+	size_t	nhits;
+	size_t	maxhits;
+};
+
+/*
+ * An index maps every NFS event to the offsets of its records in a trail,
+ * split by success and failure, so that counting or locating them takes
+ * constant time instead of a scan. It is a header whose 'start' gives the
+ * first entry of each bucket in the array of offsets that follows it.
+ * Values are in host byte order.
+ */
+#define	INDEX_MAGIC	"NFSAUIDX"
+#define	INDEX_VERSION	1
+#define	INDEX_NBUCKETS	(2 * NFS_NEVENTS)
+
+struct index_header {
+	char	magic[8];
+	uint32_t	version;
+	uint32_t	first_event;
+	uint32_t	nevents;
+	uint32_t	pad;
+	uint64_t	trail_size;
+	uint64_t	start[INDEX_NBUCKETS + 1];
+};
+
+static void usage(void) __dead2;
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: nfs-audit-trail replay [-co] [-n loops] "
+	    "-m event[:success|failure[:regex]] ... file\n"
+	    "       nfs-audit-trail scan [-l] [-e event] ... "
+	    "[-j threads] [-s success|failure] file\n"
+	    "       nfs-audit-trail index [-j threads] file index\n"
+	    "       nfs-audit-trail query [-l] [-c count] "
+	    "[-s success|failure] index event ...\n"
+	    "       nfs-audit-trail generate [-e event[:weight]] ... "
+	    "[-f percent]\n"
+	    "           [-l min[:max]] [-n count] [-r rate] [-s seed] "
+	    "[-u uid] file\n");
+	exit(2);
+}
+
+static double
+elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - start->tv_sec) +
+	    (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+/*
+ * Accepts an event either by number or by its name in audit_event(5).
+ */
+static int
+parse_event(const char *name)
+{
+	struct au_event_ent *ev;
+	char *end;
+	long event;
+
+	if (strcmp(name, "any") == 0)
+		return (AU_MATCH_ANYEVENT);
+	event = strtol(name, &end, 10);
+	if (*end == '\0' && end != name)
+		return (event);
+	if ((ev = getauevnam(name)) == NULL)
+		errx(2, "unknown audit event %s", name);
+	return (ev->ae_number);
+}
+
+static int
+parse_status(const char *status)
+{
+	if (strcmp(status, "success") == 0)
+		return (AU_MATCH_SUCCESS);
+	if (strcmp(status, "failure") == 0)
+		return (AU_MATCH_FAILURE);
+	errx(2, "invalid status %s", status);
+}
+
+/*
+ * Build an expected record from "event[:success|failure[:regex]]".
+ */
+static void
+parse_match(struct au_match *match, char *spec)
+{
+	char *event, *status, *regex;
+	int st = AU_MATCH_ANY;
+
+	event = strsep(&spec, ":");
+	status = strsep(&spec, ":");
+	regex = spec;
+
+	if (status != NULL && strcmp(status, "success") == 0)
+		st = AU_MATCH_SUCCESS;
+	else if (status != NULL && strcmp(status, "failure") == 0)
+		st = AU_MATCH_FAILURE;
+	else if (status != NULL && *status != '\0' &&
+	    strcmp(status, "any") != 0)
+		errx(2, "invalid status %s", status);
+
+	au_match_init(match, parse_event(event), st);
+	if (regex != NULL && au_match_regex(match, regex) != 0)
+		errx(2, "invalid regex %s", regex);
+}
+
+/*
+ * Run the matcher of check_auditpipe() over a capture file mapped in
+ * memory, without any kernel audit involved. By default the replay stops
+ * once all the expected records are found, like the tests do. With "-c"
+ * every record is checked, which measures the raw matcher throughput.
+ */
+static int
+replay_main(int argc, char *argv[])
+{
+	struct au_match matches[MAXMATCH];
+	struct au_framer framer;
+	struct au_arena arena;
+	struct timespec start;
+	bool found[MAXMATCH];
+	bool ordered = false, all = false;
+	char descr[256];
+	u_char *buf;
+	size_t reclen;
+	uintmax_t records = 0, hits = 0;
+	long loops = 1, loop;
+	int ch, error, i, left, nmatch = 0, status;
+	double secs;
+
+	while ((ch = getopt(argc, argv, "cm:n:o")) != -1) {
+		switch (ch) {
+		case 'c':
+			all = true;
+			break;
+		case 'm':
+			if (nmatch == MAXMATCH)
+				errx(2, "too many expected records");
+			parse_match(&matches[nmatch++], optarg);
+			break;
+		case 'n':
+			if ((loops = strtol(optarg, NULL, 10)) <= 0)
+				errx(2, "invalid loop count %s", optarg);
+			break;
+		case 'o':
+			ordered = true;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || nmatch == 0)
+		usage();
+
+	if (au_framer_map(&framer, argv[0]) != 0)
+		err(1, "%s", argv[0]);
+	if (au_arena_init(&arena) != 0)
+		err(1, "open_memstream");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (loop = 0; loop < loops; loop++) {
+		memset(found, 0, sizeof(found));
+		left = nmatch;
+		i = -1;
+		framer.start = 0;
+		while ((error = au_framer_next(&framer, &buf, &reclen)) == 1) {
+			records++;
+			i = au_match_next(matches, found, nmatch, ordered,
+			    &arena, buf, reclen);
+			if (i == -2)
+				break;
+			if (i == -1)
+				continue;
+			hits++;
+			if (!all)
+				found[i] = true;
+			if (!all && --left == 0)
+				break;
+		}
+		if (error == -1 || i == -2)
+			errx(1, "%s: malformed record at offset %zu", argv[0],
+			    framer.start);
+	}
+	secs = elapsed(&start);
+
+	printf("records=%ju matched=%ju seconds=%.6f records_per_sec=%.0f\n",
+	    records, hits, secs, secs > 0 ? records / secs : 0);
+	status = all ? (hits == 0) : (left != 0);
+
+	for (i = 0; i < nmatch; i++) {
+		if (!all) {
+			au_match_describe(&matches[i], descr, sizeof(descr));
+			printf("%s: %s\n", found[i] ? "found" : "missing",
+			    descr);
+		}
+		au_match_free(&matches[i]);
+	}
+	au_arena_free(&arena);
+	au_framer_free(&framer);
+	return (status);
+}
+
+static void
+scan_keep(struct scan_job *job, size_t off, int bucket)
+{
+	struct scan_hit *hits;
+
+	if (job->nhits == job->maxhits) {
+		job->maxhits = job->maxhits ? job->maxhits * 2 : 1024;
+		hits = realloc(job->hits, job->maxhits * sizeof(*hits));
+		if (hits == NULL)
+			err(1, "realloc");
+		job->hits = hits;
+	}
+	job->hits[job->nhits].offset = off;
+	job->hits[job->nhits++].bucket = bucket;
+}
+
+/*
+ * Walk the records of a job in place by their header byte count. Only the
+ * event id and return status are read, see au_rec_status(), so nothing is
+ * copied or parsed for records of no interest. Selected records without a
+ * return token are counted apart as neither success nor failure. Garbage
+ * in the middle of a trail is skipped up to the next record boundary.
+ */
+static void *
+scan_range(void *arg)
+{
+	struct scan_job *job = arg;
+	size_t off = job->start, len;
+	int event, ret;
+	bool success;
+
+	while (off < job->end) {
+		if ((len = au_rec_len(job->buf + off, job->size - off)) == 0) {
+			job->malformed++;
+			off++;
+			off += au_rec_sync(job->buf + off, job->end - off);
+			continue;
+		}
+		job->records++;
+
+		event = au_rec_event(job->buf + off, len);
+		if (NFS_EVENT(event) && job->events[event - NFS_EVENT_FIRST]) {
+			ret = au_rec_status(job->buf + off, len);
+			if (ret == -1) {
+				/* Neither a success nor a failure */
+				job->noreturn++;
+				off += len;
+				continue;
+			}
+			success = (ret == 0);
+			if (job->status == AU_MATCH_ANY ||
+			    (job->status == AU_MATCH_SUCCESS) == success) {
+				job->counts[event - NFS_EVENT_FIRST][!success]++;
+				if (job->list)
+					scan_keep(job, off,
+					    2 * (event - NFS_EVENT_FIRST) +
+					    !success);
+			}
+		}
+		off += len;
+	}
+	return (NULL);
+}
+
+static const char *
+event_name(int event)
+{
+	struct au_event_ent *ev;
+
+	return ((ev = getauevnum(event)) != NULL ? ev->ae_name : "unknown");
+}
+
+/*
+ * Split the trail mapped by "framer" at record boundaries between up to
+ * "njobs" threads and start them. Returns the number of threads started.
+ */
+static int
+scan_start(struct scan_job jobs[], long njobs, struct au_framer *framer,
+    const bool events[], int status, bool list)
+{
+	struct scan_job *job;
+	size_t off;
+	int j;
+
+	if ((size_t)njobs > framer->size / SCAN_MINCHUNK)
+		njobs = framer->size / SCAN_MINCHUNK;
+	if (njobs > SCAN_MAXJOBS)
+		njobs = SCAN_MAXJOBS;
+	if (njobs < 1)
+		njobs = 1;
+
+	memset(jobs, 0, njobs * sizeof(*jobs));
+	for (j = 0, off = 0; j < njobs; j++) {
+		job = &jobs[j];
+		job->buf = framer->buf;
+		job->size = framer->size;
+		job->events = events;
+		job->status = status;
+		job->list = list;
+		job->start = off;
+		if (j == njobs - 1) {
+			job->end = framer->size;
+		} else {
+			off = framer->size / njobs * (j + 1);
+			if (off < job->start)
+				off = job->start;
+			off += au_rec_sync(framer->buf + off,
+			    framer->size - off);
+			job->end = off;
+		}
+		if (pthread_create(&job->thread, NULL, scan_range, job) != 0)
+			errx(1, "pthread_create");
+	}
+	return (njobs);
+}
+
+/*
+ * Count the NFS records of a trail by event and return status, splitting
+ * large trails between threads at record boundaries.
+ */
+static int
+scan_main(int argc, char *argv[])
+{
+	struct scan_job jobs[SCAN_MAXJOBS], *job;
+	struct au_framer framer;
+	struct timespec start;
+	bool events[NFS_NEVENTS], list = false, selected = false;
+	uintmax_t counts[NFS_NEVENTS][2], records = 0, malformed = 0;
+	uintmax_t noreturn = 0;
+	size_t i;
+	long njobs;
+	int ch, event, status = AU_MATCH_ANY, j;
+
+	memset(events, 0, sizeof(events));
+	memset(counts, 0, sizeof(counts));
+	njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((ch = getopt(argc, argv, "e:j:ls:")) != -1) {
+		switch (ch) {
+		case 'e':
+			event = parse_event(optarg);
+			if (!NFS_EVENT(event))
+				errx(2, "%s is not an NFS event", optarg);
+			events[event - NFS_EVENT_FIRST] = true;
+			selected = true;
+			break;
+		case 'j':
+			njobs = strtol(optarg, NULL, 10);
+			break;
+		case 'l':
+			list = true;
+			break;
+		case 's':
+			status = parse_status(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+	if (!selected)
+		memset(events, true, sizeof(events));
+
+	if (au_framer_map(&framer, argv[0]) != 0)
+		err(1, "%s", argv[0]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	njobs = scan_start(jobs, njobs, &framer, events, status, list);
+	for (j = 0; j < njobs; j++) {
+		job = &jobs[j];
+		pthread_join(job->thread, NULL);
+		records += job->records;
+		malformed += job->malformed;
+		noreturn += job->noreturn;
+		for (i = 0; i < NFS_NEVENTS; i++) {
+			counts[i][0] += job->counts[i][0];
+			counts[i][1] += job->counts[i][1];
+		}
+		for (i = 0; i < job->nhits; i++) {
+			event = NFS_EVENT_FIRST + job->hits[i].bucket / 2;
+			printf("offset %zu %s(%d) return,%s\n",
+			    job->hits[i].offset, event_name(event), event,
+			    job->hits[i].bucket % 2 ? "failure" : "success");
+		}
+		free(job->hits);
+	}
+
+	printf("%-32s %6s %12s %12s\n", "event", "id", "success",
+	    "failure");
+	for (i = 0; i < NFS_NEVENTS; i++) {
+		if (counts[i][0] == 0 && counts[i][1] == 0)
+			continue;
+		event = NFS_EVENT_FIRST + i;
+		printf("%-32s %6d %12ju %12ju\n", event_name(event), event,
+		    counts[i][0], counts[i][1]);
+	}
+	printf("records=%ju malformed=%ju noreturn=%ju threads=%ld "
+	    "seconds=%.6f\n", records, malformed, noreturn, njobs,
+	    elapsed(&start));
+
+	au_framer_free(&framer);
+	return (malformed != 0);
+}
+
+static void
+write_all(int fd, const void *buf, size_t len, const char *path)
+{
+	const char *p = buf;
+	ssize_t nwritten;
+
+	while (len > 0) {
+		if ((nwritten = write(fd, p, len)) == -1)
+			err(1, "%s", path);
+		p += nwritten;
+		len -= nwritten;
+	}
+}
+
+/*
+ * Build the index of a trail in a single scan. The offsets are gathered
+ * per thread, then laid out bucket after bucket, in trail order within
+ * each bucket since the threads cover consecutive parts of the trail.
+ */
+static int
+index_main(int argc, char *argv[])
+{
+	struct scan_job jobs[SCAN_MAXJOBS], *job;
+	struct index_header hdr;
+	struct au_framer framer;
+	bool events[NFS_NEVENTS];
+	uint64_t *offsets, next[INDEX_NBUCKETS];
+	uintmax_t malformed = 0, noreturn = 0;
+	char tmp[PATH_MAX];
+	size_t i;
+	long njobs;
+	int ch, fd, j, b;
+
+	njobs = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((ch = getopt(argc, argv, "j:")) != -1) {
+		switch (ch) {
+		case 'j':
+			njobs = strtol(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2)
+		usage();
+
+	if (au_framer_map(&framer, argv[0]) != 0)
+		err(1, "%s", argv[0]);
+	memset(events, true, sizeof(events));
+	njobs = scan_start(jobs, njobs, &framer, events, AU_MATCH_ANY, true);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.version = INDEX_VERSION;
+	hdr.first_event = NFS_EVENT_FIRST;
+	hdr.nevents = NFS_NEVENTS;
+	hdr.trail_size = framer.size;
+	for (j = 0; j < njobs; j++) {
+		pthread_join(jobs[j].thread, NULL);
+		malformed += jobs[j].malformed;
+		noreturn += jobs[j].noreturn;
+		for (b = 0; b < INDEX_NBUCKETS; b++)
+			hdr.start[b + 1] += jobs[j].counts[b / 2][b % 2];
+	}
+	for (b = 0; b < INDEX_NBUCKETS; b++) {
+		hdr.start[b + 1] += hdr.start[b];
+		next[b] = hdr.start[b];
+	}
+
+	if ((offsets = calloc(hdr.start[INDEX_NBUCKETS] + 1,
+	    sizeof(*offsets))) == NULL)
+		err(1, "calloc");
+	for (j = 0; j < njobs; j++) {
+		job = &jobs[j];
+		for (i = 0; i < job->nhits; i++)
+			offsets[next[job->hits[i].bucket]++] =
+			    job->hits[i].offset;
+		free(job->hits);
+	}
+
+	/* Replace any previous index only once the new one is complete */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", argv[1]);
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+		err(1, "%s", tmp);
+	write_all(fd, &hdr, sizeof(hdr), tmp);
+	write_all(fd, offsets, hdr.start[INDEX_NBUCKETS] * sizeof(*offsets),
+	    tmp);
+	if (close(fd) != 0 || rename(tmp, argv[1]) != 0)
+		err(1, "%s", argv[1]);
+
+	printf("indexed=%ju malformed=%ju noreturn=%ju\n",
+	    (uintmax_t)hdr.start[INDEX_NBUCKETS], malformed, noreturn);
+	free(offsets);
+	au_framer_free(&framer);
+	return (malformed != 0);
+}
+
+/*
+ * Answer from an index how many records of the given events there are,
+ * reading only its header unless the offsets are listed. With "-c", the
+ * exit status tells whether the total is the expected count.
+ */
+static int
+query_main(int argc, char *argv[])
+{
+	struct index_header hdr;
+	uint64_t off, recoff;
+	uintmax_t total = 0, n;
+	long expected = -1;
+	bool list = false;
+	int ch, fd, event, status = AU_MATCH_ANY, b, i;
+	const char *name[] = { "success", "failure" };
+
+	while ((ch = getopt(argc, argv, "c:ls:")) != -1) {
+		switch (ch) {
+		case 'c':
+			expected = strtol(optarg, NULL, 10);
+			break;
+		case 'l':
+			list = true;
+			break;
+		case 's':
+			status = parse_status(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 2)
+		usage();
+
+	if ((fd = open(argv[0], O_RDONLY)) == -1)
+		err(1, "%s", argv[0]);
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    memcmp(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.version != INDEX_VERSION || hdr.first_event != NFS_EVENT_FIRST ||
+	    hdr.nevents != NFS_NEVENTS)
+		errx(1, "%s: not an index of this version", argv[0]);
+
+	for (i = 1; i < argc; i++) {
+		event = parse_event(argv[i]);
+		if (!NFS_EVENT(event))
+			errx(2, "%s is not an NFS event", argv[i]);
+		for (b = 2 * (event - NFS_EVENT_FIRST);
+		    b < 2 * (event - NFS_EVENT_FIRST + 1); b++) {
+			if (status != AU_MATCH_ANY &&
+			    (status == AU_MATCH_FAILURE) != (b % 2))
+				continue;
+			n = hdr.start[b + 1] - hdr.start[b];
+			total += n;
+			printf("%s(%d) return,%s %ju\n", event_name(event),
+			    event, name[b % 2], n);
+			for (off = hdr.start[b]; list && off < hdr.start[b + 1];
+			    off++) {
+				if (pread(fd, &recoff, sizeof(recoff),
+				    sizeof(hdr) + off * sizeof(recoff)) !=
+				    sizeof(recoff))
+					errx(1, "%s: truncated index", argv[0]);
+				printf("offset %ju\n", (uintmax_t)recoff);
+			}
+		}
+	}
+	close(fd);
+	return (expected != -1 && total != (uintmax_t)expected);
+}
+
+/*
+ * Random path of about 'len' bytes under a directory of the generator.
+ */
+static void
+gen_path(char *path, size_t len)
+{
+	static const char prefix[] = "/nfs-audit-gen/";
+	size_t i;
+
+	snprintf(path, len + 1, "%s", prefix);
+	for (i = sizeof(prefix) - 1; i < len; i++)
+		path[i] = "abcdefghijklmnopqrstuvwxyz0123456789"[random() % 36];
+	path[len] = '\0';
+}
+
+static void
+parse_range(const char *spec, size_t *min, size_t *max)
+{
+	char *end;
+
+	*min = strtoul(spec, &end, 10);
+	*max = *end == ':' ? strtoul(end + 1, &end, 10) : *min;
+	if (*end != '\0' || *min < 16 || *max < *min || *max >= MAXPATHLEN)
+		errx(2, "invalid path length %s", spec);
+}
+
+/*
+ * Write a stream of synthetic NFS records, built like the kernel builds
+ * them, to a file, a FIFO or the standard output ("-"). The events are
+ * picked at random according to their weight, the NFSv3 ones by default,
+ * and fail with ENOENT in the given share of the records. Records go out
+ * as fast as the reader takes them, or at the given rate per second,
+ * which finds the highest rate check_auditpipe() keeps up with when the
+ * FIFO is the one of an nfs-audit-standin directory, see NFSAUDIT_STANDIN.
+ * Without -n, it runs until the reader goes away.
+ */
+static int
+generate_main(int argc, char *argv[])
+{
+	struct gen_event events[MAXMATCH];
+	struct timespec start, due;
+	static u_char buf[GEN_BUFSIZE + MAX_AUDIT_RECORD_SIZE];
+	char path1[MAXPATHLEN], path2[MAXPATHLEN];
+	char *spec, *event;
+	size_t fill, len, minlen = 16, maxlen = 128, n, nevents = 0;
+	uintmax_t count = 0, records, bytes = 0, failures = 0;
+	u_long pick, total, failpct = 10, seed;
+	double rate = 0, secs;
+	uid_t uid = 0;
+	int ch, error, fd, ev;
+
+	seed = (u_long)time(NULL);
+	while ((ch = getopt(argc, argv, "e:f:l:n:r:s:u:")) != -1) {
+		switch (ch) {
+		case 'e':
+			if (nevents == MAXMATCH)
+				errx(2, "too many events");
+			spec = optarg;
+			event = strsep(&spec, ":");
+			events[nevents].event = parse_event(event);
+			events[nevents].weight = spec != NULL ?
+			    strtoul(spec, NULL, 10) : 1;
+			if (events[nevents].event == AU_MATCH_ANYEVENT ||
+			    events[nevents].weight == 0)
+				errx(2, "invalid event %s", optarg);
+			nevents++;
+			break;
+		case 'f':
+			if ((failpct = strtoul(optarg, NULL, 10)) > 100)
+				errx(2, "invalid failure share %s", optarg);
+			break;
+		case 'l':
+			parse_range(optarg, &minlen, &maxlen);
+			break;
+		case 'n':
+			count = strtoumax(optarg, NULL, 10);
+			break;
+		case 'r':
+			if ((rate = strtod(optarg, NULL)) < 0)
+				errx(2, "invalid rate %s", optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		case 'u':
+			uid = (uid_t)strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+	if (nevents == 0) {
+		for (ev = NFS3_EVENT_FIRST; ev <= NFS3_EVENT_LAST; ev++) {
+			events[nevents].event = ev;
+			events[nevents++].weight = 1;
+		}
+	}
+	for (total = 0, n = 0; n < nevents; n++)
+		total += events[n].weight;
+
+	/* Opening an existing FIFO waits for its reader */
+	if (strcmp(argv[0], "-") == 0)
+		fd = STDOUT_FILENO;
+	else if ((fd = open(argv[0], O_WRONLY | O_CREAT | O_TRUNC,
+	    0644)) == -1)
+		err(1, "%s", argv[0]);
+	signal(SIGPIPE, SIG_IGN);
+	srandom((u_int)seed);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fill = 0;
+	records = 0;
+	while (count == 0 || records < count) {
+		/* Flush and wait for the next burst once ahead of the rate */
+		if (rate > 0 && records >= rate * elapsed(&start)) {
+			if (fill > 0 && write(fd, buf, fill) != (ssize_t)fill)
+				break;
+			bytes += fill;
+			fill = 0;
+			secs = MIN((records + 1) / rate - elapsed(&start),
+			    GEN_SLICE_NS / 1e9);
+			if (secs > 0) {
+				due.tv_sec = (time_t)secs;
+				due.tv_nsec = (long)((secs - due.tv_sec) * 1e9);
+				nanosleep(&due, NULL);
+			}
+			continue;
+		}
+
+		pick = (u_long)random() % total;
+		for (n = 0; pick >= events[n].weight; n++)
+			pick -= events[n].weight;
+		gen_path(path1, minlen + (size_t)random() %
+		    (maxlen - minlen + 1));
+		gen_path(path2, minlen + (size_t)random() %
+		    (maxlen - minlen + 1));
+		error = (u_long)random() % 100 < failpct ? ENOENT : 0;
+		if (error != 0)
+			failures++;
+		records++;
+
+		len = sizeof(buf) - fill;
+		if (au_rec_build(buf + fill, &len, events[n].event, uid, uid,
+		    error, path1, events[n].event == AUE_NFS3RPC_RENAME ||
+		    events[n].event == AUE_NFS3RPC_LINK ? path2 : NULL) != 0)
+			errx(1, "au_rec_build: record too long");
+		fill += len;
+		if (fill >= GEN_BUFSIZE) {
+			if (write(fd, buf, fill) != (ssize_t)fill)
+				break;
+			bytes += fill;
+			fill = 0;
+		}
+	}
+	if (fill > 0 && write(fd, buf, fill) == (ssize_t)fill)
+		bytes += fill;
+	secs = elapsed(&start);
+	if (fd != STDOUT_FILENO)
+		close(fd);
+
+	fprintf(stderr, "records=%ju failures=%ju bytes=%ju seconds=%.6f "
+	    "records_per_sec=%.0f\n", records, failures, bytes, secs,
+	    secs > 0 ? records / secs : 0);
+	return (count != 0 && records != count);
+}
+
+static const struct {
+	const char	*name;
+	int		(*main)(int, char *[]);
+} commands[] = {
+	{ "replay",	replay_main },
+	{ "scan",	scan_main },
+	{ "index",	index_main },
+	{ "query",	query_main },
+	{ "generate",	generate_main },
+};
+
+int
+main(int argc, char *argv[])
+{
+	size_t i;
+
+	if (argc < 2)
+		usage();
+	for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+		if (strcmp(argv[1], commands[i].name) == 0)
+			return (commands[i].main(argc - 1, argv + 1));
+	}
+	usage();
+}
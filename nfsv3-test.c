@@ -16,21 +16,38 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include <atf-c.h>
 #include <fcntl.h>
+#include <math.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include "utils.h"
+#include "compat.h"
 
 static struct pollfd fds[1];
 static const char *auclass = "nfs";
 static char path[] = "fileforaudit";
-static const char *successreg = "fileforaudit.*return,success";
-static const char *failurereg = "fileforaudit.*return,failure";
+
+/* RPCs in flight at once on the context of nfs3_pipelined_getattr */
+#define	PIPELINE_DEPTH		8
+#define	PIPELINE_TIMEOUT_MS	10000
+
+/* Contexts serviced together with the auditpipe by nfs3_loop_getattr */
+#define	LOOP_CONTEXTS		4
+#define	LOOP_TIMEOUT_MS		10000
+
+/* Stall of the replies of nfs-audit-standin, for nfs3_latency_stalled */
+#define	STALL_MS		200
+#define	STALL_RPCS		3
+
+/* Deadline of nfs3_deadline_cancel, well short of the stall of its reply */
+#define	DEADLINE_MS		200
+#define	DEADLINE_STALL_MS	5000
 
 ATF_TC_WITH_CLEANUP(nfs3_getattr_success);
 ATF_TC_HEAD(nfs3_getattr_success, tc)
@@ -41,25 +58,27 @@ ATF_TC_HEAD(nfs3_getattr_success, tc)
 
 ATF_TC_BODY(nfs3_getattr_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	GETATTR3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR, &au_test_data);
-	const char *regex = "nfsrvd_getattr.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
 	pipefd = setup(fds, auclass);
 	args.object = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_getattr_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_GETATTR, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_getattr_success, tc)
@@ -76,15 +95,16 @@ ATF_TC_HEAD(nfs3_getattr_failure, tc)
 
 ATF_TC_BODY(nfs3_getattr_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	GETATTR3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR, &au_test_data);
-	const char *regex = "nfsrvd_getattr.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -92,11 +112,12 @@ ATF_TC_BODY(nfs3_getattr_failure, tc)
 	ATF_REQUIRE_EQ(0, remove(path));
 	pipefd = setup(fds, auclass);
 	args.object = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_getattr_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_GETATTR, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_getattr_failure, tc)
@@ -113,15 +134,16 @@ ATF_TC_HEAD(nfs3_setattr_success, tc)
 
 ATF_TC_BODY(nfs3_setattr_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	SETATTR3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_SETATTR, &au_test_data);
-	const char *regex = "nfsrvd_setattr.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -129,11 +151,12 @@ ATF_TC_BODY(nfs3_setattr_success, tc)
 	args.object = *fh3;
 	args.new_attributes.mode.set_it = 1;
 	args.new_attributes.mode.set_mode3_u.mode = 0222;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_setattr_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_setattr_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_SETATTR, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_setattr_success, tc)
@@ -149,15 +172,16 @@ ATF_TC_HEAD(nfs3_setattr_failure, tc)
 }
 ATF_TC_BODY(nfs3_setattr_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	SETATTR3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_SETATTR, &au_test_data);
-	const char *regex = "nfsrvd_setattr.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -167,11 +191,12 @@ ATF_TC_BODY(nfs3_setattr_failure, tc)
 	args.object = *fh3;
 	args.new_attributes.mode.set_it = 1;
 	args.new_attributes.mode.set_mode3_u.mode = 0222;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_setattr_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_setattr_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_SETATTR, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_setattr_failure, tc)
@@ -188,21 +213,25 @@ ATF_TC_HEAD(nfs3_lookup_success, tc)
 
 ATF_TC_BODY(nfs3_lookup_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_LOOKUP, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	LOOKUP3args args;
 
 	args.what.dir.data.data_len = nfs->rootfh.len;
 	args.what.dir.data.data_val = nfs->rootfh.val;
 	args.what.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_lookup_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_lookup_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_LOOKUP, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_lookup_success, tc)
@@ -219,20 +248,24 @@ ATF_TC_HEAD(nfs3_lookup_failure, tc)
 
 ATF_TC_BODY(nfs3_lookup_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_LOOKUP, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	LOOKUP3args args;
 	
 	/* There is no file. */
 	args.what.dir.data.data_len = nfs->rootfh.len;
 	args.what.dir.data.data_val = nfs->rootfh.val;
 	args.what.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_lookup_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_lookup_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_LOOKUP, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_lookup_failure, tc)
@@ -249,26 +282,28 @@ ATF_TC_HEAD(nfs3_access_success, tc)
 
 ATF_TC_BODY(nfs3_access_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_ACCESS, &au_test_data);
-	FILE *pipefd;	
+	struct au_pipe *pipefd;	
 	ACCESS3args args;
-	const char *regex = "nfsrvd_access.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
 	pipefd = setup(fds, auclass);
 	args.object  = *fh3;
 	args.access = ACCESS3_READ;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_access_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_access_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_ACCESS, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_access_success, tc)
@@ -285,15 +320,16 @@ ATF_TC_HEAD(nfs3_access_failure, tc)
 
 ATF_TC_BODY(nfs3_access_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0222) != -1);
 
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_ACCESS, &au_test_data);
-	FILE *pipefd;	
+	struct au_pipe *pipefd;	
 	ACCESS3args args;
-	const char *regex = "nfsrvd_access.*return,failure";
 
 	/* Remove the file. The resulting error is Stale NFS file handle. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
@@ -302,11 +338,12 @@ ATF_TC_BODY(nfs3_access_failure, tc)
 	pipefd = setup(fds, auclass);
 	args.object  = *fh3;
 	args.access = ACCESS3_READ | ACCESS3_EXECUTE;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_access_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_access_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_ACCESS, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_access_failure, tc)
@@ -323,19 +360,21 @@ ATF_TC_HEAD(nfs3_readlink_success, tc)
 
 ATF_TC_BODY(nfs3_readlink_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, symlink(path, "symlink"));
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READLINK, &au_test_data);
-	FILE *pipefd;
+	struct au_pipe *pipefd;
 	char buf[PATH_MAX];
-	const char *regex = "nfsrvd_readlink.*return,success";
 
 	nfs->version = NFS_V3;
 	pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, nfs_readlink(nfs, "symlink", buf, sizeof(buf)));
 	ATF_REQUIRE_MATCH(buf, path);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READLINK, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readlink_success, tc)
@@ -352,19 +391,21 @@ ATF_TC_HEAD(nfs3_readlink_failure, tc)
 
 ATF_TC_BODY(nfs3_readlink_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READLINK, &au_test_data);
-	FILE *pipefd;
+	struct au_pipe *pipefd;
 	char buf[PATH_MAX];
-	const char *regex = "nfsrvd_readlink.*return,failure";
 
 	/* The path is regular file not symlink, readlink results in error. */
 	nfs->version = NFS_V3;
 	pipefd = setup(fds, auclass);
 	ATF_REQUIRE(nfs_readlink(nfs, path, buf, sizeof(buf)) != 0);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READLINK, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readlink_failure, tc)
@@ -381,15 +422,16 @@ ATF_TC_HEAD(nfs3_read_success, tc)
 
 ATF_TC_BODY(nfs3_read_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	READ3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READ, &au_test_data);
-	const char *regex = "nfsrvd_read.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -397,11 +439,12 @@ ATF_TC_BODY(nfs3_read_success, tc)
 	args.file = *fh3;
 	args.offset = 0;
 	args.count = 1;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_read_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_read_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READ, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_read_success, tc)
@@ -418,15 +461,16 @@ ATF_TC_HEAD(nfs3_read_failure, tc)
 
 ATF_TC_BODY(nfs3_read_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	READ3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READ, &au_test_data);
-	const char *regex = "nfsrvd_read.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -435,11 +479,12 @@ ATF_TC_BODY(nfs3_read_failure, tc)
 	args.file = *fh3;
 	args.offset = 0;
 	args.count = 1;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_read_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_read_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READ, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_read_failure, tc)
@@ -456,15 +501,16 @@ ATF_TC_HEAD(nfs3_write_success, tc)
 
 ATF_TC_BODY(nfs3_write_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	WRITE3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_WRITE, &au_test_data);
-	const char *regex = "nfsrvd_write.*return,success";
 	char buf[] = "NFS AUDIT Test Write";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_WRONLY, &nfsfh));
@@ -476,11 +522,12 @@ ATF_TC_BODY(nfs3_write_success, tc)
 	args.stable = FILE_SYNC;
 	args.data.data_len = strlen(buf);
 	args.data.data_val = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_write_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_write_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_WRITE, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_write_success, tc)
@@ -497,15 +544,16 @@ ATF_TC_HEAD(nfs3_write_failure, tc)
 
 ATF_TC_BODY(nfs3_write_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	WRITE3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_WRITE, &au_test_data);
-	const char *regex = "nfsrvd_write.*return,failure";
 	char buf[] = "NFS AUDIT Test Write";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_WRONLY, &nfsfh));
@@ -518,11 +566,12 @@ ATF_TC_BODY(nfs3_write_failure, tc)
 	args.stable = FILE_SYNC;
 	args.data.data_len = strlen(buf);
 	args.data.data_val = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_write_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_write_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_WRITE, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_write_failure, tc)
@@ -539,9 +588,11 @@ ATF_TC_HEAD(nfs3_create_success, tc)
 
 ATF_TC_BODY(nfs3_create_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_CREATE, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	CREATE3args args;
 
 	args.where.dir.data.data_len = nfs->rootfh.len;
@@ -550,11 +601,13 @@ ATF_TC_BODY(nfs3_create_success, tc)
 	args.how.mode = GUARDED; /* Similiar to case if O_EXCL flag is provided with O_CREAT. */
 	args.how.createhow3_u.obj_attributes.mode.set_it = 1;
 	args.how.createhow3_u.obj_attributes.mode.set_mode3_u.mode = 0755;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_create_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_create_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_CREATE, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_create_success, tc)
@@ -571,12 +624,14 @@ ATF_TC_HEAD(nfs3_create_failure, tc)
 
 ATF_TC_BODY(nfs3_create_failure, tc)
 {
+	tc_workdir();
 	/* The RPC result status is an error as file already exits. */
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_CREATE, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	CREATE3args args;
 
 	args.where.dir.data.data_len = nfs->rootfh.len;
@@ -585,11 +640,13 @@ ATF_TC_BODY(nfs3_create_failure, tc)
 	args.how.mode = GUARDED; /* Similiar to case if O_EXCL flag is provided with O_CREAT. */
 	args.how.createhow3_u.obj_attributes.mode.set_it = 1;
 	args.how.createhow3_u.obj_attributes.mode.set_mode3_u.mode = 0755;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_create_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_create_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_CREATE, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_create_failure, tc)
@@ -606,9 +663,11 @@ ATF_TC_HEAD(nfs3_mkdir_success, tc)
 
 ATF_TC_BODY(nfs3_mkdir_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_MKDIR, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	MKDIR3args args;
 
 	args.where.dir.data.data_len = nfs->rootfh.len;
@@ -616,11 +675,13 @@ ATF_TC_BODY(nfs3_mkdir_success, tc)
 	args.where.name = path;
 	args.attributes.mode.set_it = 1;
 	args.attributes.mode.set_mode3_u.mode = 0755;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_mkdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_mkdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_MKDIR, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_mkdir_success, tc)
@@ -637,12 +698,14 @@ ATF_TC_HEAD(nfs3_mkdir_failure, tc)
 
 ATF_TC_BODY(nfs3_mkdir_failure, tc)
 {
+	tc_workdir();
 	/* The RPC result status is an error as file already exits. */
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_MKDIR, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	MKDIR3args args;
 
 	args.where.dir.data.data_len = nfs->rootfh.len;
@@ -650,11 +713,13 @@ ATF_TC_BODY(nfs3_mkdir_failure, tc)
 	args.where.name = path;
 	args.attributes.mode.set_it = 1;
 	args.attributes.mode.set_mode3_u.mode = 0755;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_mkdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_mkdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_MKDIR, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_mkdir_failure, tc)
@@ -671,8 +736,10 @@ ATF_TC_HEAD(nfs3_symlink_success, tc)
 
 ATF_TC_BODY(nfs3_symlink_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	SYMLINK3args args;
 	char buf[] = "symlink";
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_SYMLINK, &au_test_data);
@@ -684,11 +751,13 @@ ATF_TC_BODY(nfs3_symlink_success, tc)
 	args.symlink.symlink_attributes.mode.set_it = 1;
 	args.symlink.symlink_attributes.mode.set_mode3_u.mode = S_IRUSR|S_IWUSR|S_IXUSR;
 	args.symlink.symlink_data = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_symlink_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_symlink_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_SYMLINK, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_symlink_success, tc)
@@ -705,8 +774,10 @@ ATF_TC_HEAD(nfs3_symlink_failure, tc)
 
 ATF_TC_BODY(nfs3_symlink_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	SYMLINK3args args;
 	char buf[] = "symlink";
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_SYMLINK, &au_test_data);
@@ -719,11 +790,13 @@ ATF_TC_BODY(nfs3_symlink_failure, tc)
 	args.symlink.symlink_attributes.mode.set_it = 1;
 	args.symlink.symlink_attributes.mode.set_mode3_u.mode = S_IRUSR|S_IWUSR|S_IXUSR;
 	args.symlink.symlink_data = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_symlink_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_symlink_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_SYMLINK, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_symlink_failure, tc)
@@ -740,8 +813,10 @@ ATF_TC_HEAD(nfs3_mknod_success, tc)
 
 ATF_TC_BODY(nfs3_mknod_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	MKNOD3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_MKNOD, &au_test_data);
 
@@ -755,11 +830,13 @@ ATF_TC_BODY(nfs3_mknod_success, tc)
 	args.what.mknoddata3_u.chr_device.dev_attributes.mode.set_mode3_u.mode = S_IRUSR|S_IWUSR|S_IXUSR;
 	args.what.mknoddata3_u.chr_device.spec.specdata1 = 1; /* Major Number */
 	args.what.mknoddata3_u.chr_device.spec.specdata2 = 1; /* Minor Number */
-	ATF_REQUIRE_EQ(0, rpc_nfs3_mknod_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_mknod_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_MKNOD, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_mknod_success, tc)
@@ -776,10 +853,12 @@ ATF_TC_HEAD(nfs3_mknod_failure, tc)
 
 ATF_TC_BODY(nfs3_mknod_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	MKNOD3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_MKNOD, &au_test_data);
 
@@ -793,11 +872,13 @@ ATF_TC_BODY(nfs3_mknod_failure, tc)
 	args.what.mknoddata3_u.chr_device.dev_attributes.mode.set_mode3_u.mode = S_IRUSR|S_IWUSR|S_IXUSR;
 	args.what.mknoddata3_u.chr_device.spec.specdata1 = 1; /* Major Number */
 	args.what.mknoddata3_u.chr_device.spec.specdata2 = 1; /* Minor Number */
-	ATF_REQUIRE_EQ(0, rpc_nfs3_mknod_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_mknod_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_MKNOD, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_mknod_failure, tc)
@@ -814,22 +895,26 @@ ATF_TC_HEAD(nfs3_remove_success, tc)
 
 ATF_TC_BODY(nfs3_remove_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	REMOVE3args args;
-	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR, &au_test_data);
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_REMOVE, &au_test_data);
 
 	pipefd = setup(fds, auclass);
 	args.object.dir.data.data_len = nfs->rootfh.len;
 	args.object.dir.data.data_val = nfs->rootfh.val;
 	args.object.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_remove_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_remove_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_REMOVE, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_remove_success, tc)
@@ -846,20 +931,24 @@ ATF_TC_HEAD(nfs3_remove_failure, tc)
 
 ATF_TC_BODY(nfs3_remove_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	REMOVE3args args;
-	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR, &au_test_data);
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_REMOVE, &au_test_data);
 
 	pipefd = setup(fds, auclass);
 	args.object.dir.data.data_len = nfs->rootfh.len;
 	args.object.dir.data.data_val = nfs->rootfh.val;
 	args.object.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_remove_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_remove_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_REMOVE, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_remove_failure, tc)
@@ -876,10 +965,12 @@ ATF_TC_HEAD(nfs3_rmdir_success, tc)
 
 ATF_TC_BODY(nfs3_rmdir_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	RMDIR3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_RMDIR, &au_test_data);
 
@@ -887,11 +978,13 @@ ATF_TC_BODY(nfs3_rmdir_success, tc)
 	args.object.dir.data.data_len = nfs->rootfh.len;
 	args.object.dir.data.data_val = nfs->rootfh.val;
 	args.object.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_rmdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_rmdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_RMDIR, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_rmdir_success, tc)
@@ -908,8 +1001,10 @@ ATF_TC_HEAD(nfs3_rmdir_failure, tc)
 
 ATF_TC_BODY(nfs3_rmdir_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	RMDIR3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_RMDIR, &au_test_data);
 
@@ -917,11 +1012,13 @@ ATF_TC_BODY(nfs3_rmdir_failure, tc)
 	args.object.dir.data.data_len = nfs->rootfh.len;
 	args.object.dir.data.data_val = nfs->rootfh.val;
 	args.object.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_rmdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_rmdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_RMDIR, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_rmdir_failure, tc)
@@ -938,10 +1035,12 @@ ATF_TC_HEAD(nfs3_rename_success, tc)
 
 ATF_TC_BODY(nfs3_rename_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	RENAME3args args;
 	char buf[] = "newnameforfile";
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_RENAME, &au_test_data);
@@ -953,11 +1052,13 @@ ATF_TC_BODY(nfs3_rename_success, tc)
 	args.to.dir.data.data_len = nfs->rootfh.len;
 	args.to.dir.data.data_val = nfs->rootfh.val;
 	args.to.name = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_rename_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_rename_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_RENAME, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_rename_success, tc)
@@ -974,8 +1075,10 @@ ATF_TC_HEAD(nfs3_rename_failure, tc)
 
 ATF_TC_BODY(nfs3_rename_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	RENAME3args args;
 	char buf[] = "newnameforfile";
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_RENAME, &au_test_data);
@@ -987,11 +1090,13 @@ ATF_TC_BODY(nfs3_rename_failure, tc)
 	args.to.dir.data.data_len = nfs->rootfh.len;
 	args.to.dir.data.data_val = nfs->rootfh.val;
 	args.to.name = buf;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_rename_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_rename_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_RENAME, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_rename_failure, tc)
@@ -1008,10 +1113,12 @@ ATF_TC_HEAD(nfs3_link_success, tc)
 
 ATF_TC_BODY(nfs3_link_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open("ATestFile", O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	LINK3args args;
@@ -1024,11 +1131,13 @@ ATF_TC_BODY(nfs3_link_success, tc)
 	args.link.dir.data.data_len = nfs->rootfh.len;
 	args.link.dir.data.data_val = nfs->rootfh.val;
 	args.link.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_link_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_link_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, successreg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_LINK, AU_MATCH_SUCCESS);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_link_success, tc)
@@ -1045,10 +1154,12 @@ ATF_TC_HEAD(nfs3_link_failure, tc)
 
 ATF_TC_BODY(nfs3_link_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open("ATestFile", O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	LINK3args args;
@@ -1063,11 +1174,13 @@ ATF_TC_BODY(nfs3_link_failure, tc)
 	args.link.dir.data.data_len = nfs->rootfh.len;
 	args.link.dir.data.data_val = nfs->rootfh.val;
 	args.link.name = path;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_link_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_link_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, failurereg, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_LINK, AU_MATCH_FAILURE);
+	match.text = path;
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_link_failure, tc)
@@ -1084,24 +1197,26 @@ ATF_TC_HEAD(nfs3_readdir_success, tc)
 
 ATF_TC_BODY(nfs3_readdir_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READDIR, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	READDIR3args args;
-	const char *regex = "nfsrvd_readdir.*return,success";
 
 	args.dir.data.data_len = nfs->rootfh.len;
 	args.dir.data.data_val = nfs->rootfh.val;
 	args.cookie = 0;
 	memset(&args.cookieverf, 0, sizeof(cookieverf3));
 	args.count = 8192;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_readdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_readdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READDIR, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readdir_success, tc)
@@ -1118,24 +1233,26 @@ ATF_TC_HEAD(nfs3_readdir_failure, tc)
 
 ATF_TC_BODY(nfs3_readdir_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READDIR, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	READDIR3args args;
-	const char *regex = "nfsrvd_readdir.*return,failure";
 
 	args.dir.data.data_len = nfs->rootfh.len;
 	args.dir.data.data_val = nfs->rootfh.val;
 	args.cookie = -1; /* Bad cookie value throws an error. */
 	memset(&args.cookieverf, 0, sizeof(cookieverf3));
 	args.count = 8192;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_readdir_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_readdir_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READDIR, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readdir_failure, tc)
@@ -1152,13 +1269,14 @@ ATF_TC_HEAD(nfs3_readdirplus_success, tc)
 
 ATF_TC_BODY(nfs3_readdirplus_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READDIRPLUS, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	READDIRPLUS3args args;
-	const char *regex = "nfsrvd_readdirplus.*return,success";
 
 	args.dir.data.data_len = nfs->rootfh.len;
 	args.dir.data.data_val = nfs->rootfh.val;
@@ -1166,11 +1284,12 @@ ATF_TC_BODY(nfs3_readdirplus_success, tc)
 	memset(&args.cookieverf, 0, sizeof(cookieverf3));
 	args.dircount = 8192;
 	args.maxcount = 8192;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_readdirplus_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_readdirplus_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READDIRPLUS, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readdirplus_success, tc)
@@ -1187,13 +1306,14 @@ ATF_TC_HEAD(nfs3_readdirplus_failure, tc)
 
 ATF_TC_BODY(nfs3_readdirplus_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_READDIRPLUS, &au_test_data);
-	FILE *pipefd = setup(fds, auclass);	
+	struct au_pipe *pipefd = setup(fds, auclass);	
 	READDIRPLUS3args args;
-	const char *regex = "nfsrvd_readdirplus.*return,failure";
 
 	args.dir.data.data_len = nfs->rootfh.len;
 	args.dir.data.data_val = nfs->rootfh.val;
@@ -1201,11 +1321,12 @@ ATF_TC_BODY(nfs3_readdirplus_failure, tc)
 	memset(&args.cookieverf, 0, sizeof(cookieverf3));
 	args.dircount = 8192;
 	args.maxcount = 8192;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_readdirplus_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_readdirplus_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_READDIRPLUS, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_readdirplus_failure, tc)
@@ -1222,25 +1343,27 @@ ATF_TC_HEAD(nfs3_fsstat_success, tc)
 
 ATF_TC_BODY(nfs3_fsstat_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	FSSTAT3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_FSSTAT, &au_test_data);
-	const char *regex = "nfsrvd_statfs.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
 	pipefd = setup(fds, auclass);
 	args.fsroot = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_fsstat_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_fsstat_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_FSSTAT, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_fsstat_success, tc)
@@ -1257,15 +1380,16 @@ ATF_TC_HEAD(nfs3_fsstat_failure, tc)
 
 ATF_TC_BODY(nfs3_fsstat_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	FSSTAT3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_FSSTAT, &au_test_data);
-	const char *regex = "nfsrvd_statfs.*return,failure";
 
 	/* Remove the directory to get a stale file handle error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
@@ -1273,11 +1397,12 @@ ATF_TC_BODY(nfs3_fsstat_failure, tc)
 	ATF_REQUIRE_EQ(0, remove(path));
 	pipefd = setup(fds, auclass);
 	args.fsroot = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_fsstat_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_fsstat_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_FSSTAT, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_fsstat_failure, tc)
@@ -1294,25 +1419,27 @@ ATF_TC_HEAD(nfs3_fsinfo_success, tc)
 
 ATF_TC_BODY(nfs3_fsinfo_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	FSINFO3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_FSINFO, &au_test_data);
-	const char *regex = "nfsrvd_fsinfo.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
 	pipefd = setup(fds, auclass);
 	args.fsroot = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_fsinfo_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_fsinfo_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_FSINFO, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_fsinfo_success, tc)
@@ -1329,15 +1456,16 @@ ATF_TC_HEAD(nfs3_fsinfo_failure, tc)
 
 ATF_TC_BODY(nfs3_fsinfo_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, mkdir(path, 0755));
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	FSINFO3args args;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_FSINFO, &au_test_data);
-	const char *regex = "nfsrvd_fsinfo.*return,failure";
 
 	/* Remove the directory to get a stale file handle error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
@@ -1345,11 +1473,12 @@ ATF_TC_BODY(nfs3_fsinfo_failure, tc)
 	ATF_REQUIRE_EQ(0, remove(path));
 	pipefd = setup(fds, auclass);
 	args.fsroot = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_fsinfo_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_fsinfo_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_FSINFO, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_fsinfo_failure, tc)
@@ -1366,25 +1495,27 @@ ATF_TC_HEAD(nfs3_pathconf_success, tc)
 
 ATF_TC_BODY(nfs3_pathconf_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	PATHCONF3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_PATHCONF, &au_test_data);
-	const char *regex = "nfsrvd_pathconf.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
 	pipefd = setup(fds, auclass);
 	args.object = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_pathconf_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_pathconf_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_PATHCONF, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_pathconf_success, tc)
@@ -1401,15 +1532,16 @@ ATF_TC_HEAD(nfs3_pathconf_failure, tc)
 
 ATF_TC_BODY(nfs3_pathconf_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	PATHCONF3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_PATHCONF, &au_test_data);
-	const char *regex = "nfsrvd_pathconf.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -1417,11 +1549,12 @@ ATF_TC_BODY(nfs3_pathconf_failure, tc)
 	ATF_REQUIRE_EQ(0, remove(path));
 	pipefd = setup(fds, auclass);
 	args.object = *fh3;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_pathconf_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_pathconf_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_PATHCONF, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_pathconf_failure, tc)
@@ -1438,15 +1571,16 @@ ATF_TC_HEAD(nfs3_commit_success, tc)
 
 ATF_TC_BODY(nfs3_commit_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	COMMIT3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_COMMIT, &au_test_data);
-	const char *regex = "nfsrvd_commit.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -1454,11 +1588,12 @@ ATF_TC_BODY(nfs3_commit_success, tc)
 	args.file = *fh3;
 	args.offset = 0;
 	args.count = 0;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_commit_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_commit_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_COMMIT, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_commit_success, tc)
@@ -1475,15 +1610,16 @@ ATF_TC_HEAD(nfs3_commit_failure, tc)
 
 ATF_TC_BODY(nfs3_commit_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
-	FILE *pipefd;
+	struct au_match match;
+	struct au_pipe *pipefd;
 	COMMIT3args args;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_fh3 *fh3;
 	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_COMMIT, &au_test_data);
-	const char *regex = "nfsrvd_commit.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
@@ -1492,11 +1628,12 @@ ATF_TC_BODY(nfs3_commit_failure, tc)
 	args.file = *fh3;
 	args.offset = 0;
 	args.count = 0;
-	ATF_REQUIRE_EQ(0, rpc_nfs3_commit_async(nfs->rpc,
-	    (rpc_cb)nfs_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_commit_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
 	ATF_REQUIRE(NFS3_OK != au_test_data.au_rpc_result);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFS3RPC_COMMIT, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs3_commit_failure, tc)
@@ -1504,6 +1641,320 @@ ATF_TC_CLEANUP(nfs3_commit_failure, tc)
 	cleanup();
 }
 
+ATF_TC_WITH_CLEANUP(nfs3_pool_reuse);
+ATF_TC_HEAD(nfs3_pool_reuse, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of NFSv3 RPCs issued "
+					"over a pooled context checked out twice");
+}
+
+ATF_TC_BODY(nfs3_pool_reuse, tc)
+{
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data;
+	struct au_match matches[2];
+	struct au_pipe *pipefd;
+	GETATTR3args getattr;
+	ACCESS3args access;
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_fh3 *fh3;
+	struct nfs_pool *pool;
+	struct nfs_context *warm;
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR, &au_test_data);
+	char cwd[PATH_MAX];
+
+	au_match_init(&matches[0], AUE_NFS3RPC_GETATTR, AU_MATCH_SUCCESS);
+	au_match_init(&matches[1], AUE_NFS3RPC_ACCESS, AU_MATCH_SUCCESS);
+
+	ATF_REQUIRE(getcwd(cwd, sizeof(cwd)) != NULL);
+	ATF_REQUIRE((pool = nfs_pool_create(cwd, NFS_V3, 1)) != NULL);
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
+	nfs_pool_put(pool, nfs);
+	pipefd = setup(fds, auclass);
+
+	warm = nfs_pool_get(pool);
+	ATF_REQUIRE_EQ(nfs, warm);
+	getattr.object = *fh3;
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async, warm->rpc,
+	    nfs_res_close_cb, &getattr, &au_test_data));
+	ATF_REQUIRE_EQ(0, nfs_wait_rpc(warm, &au_test_data));
+	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
+	nfs_pool_put(pool, warm);
+
+	/* The same context comes back, still mounted */
+	warm = nfs_pool_get(pool);
+	ATF_REQUIRE_EQ(nfs, warm);
+	au_rpc_init(&au_test_data, AUE_NFS3RPC_ACCESS);
+	access.object = *fh3;
+	access.access = ACCESS3_READ;
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_access_async, warm->rpc,
+	    nfs_res_close_cb, &access, &au_test_data));
+	ATF_REQUIRE_EQ(0, nfs_wait_rpc(warm, &au_test_data));
+	ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
+	nfs_pool_put(pool, warm);
+	nfs_pool_destroy(pool);
+	check_audit_set(fds, matches, nitems(matches), true, pipefd);
+}
+
+ATF_TC_CLEANUP(nfs3_pool_reuse, tc)
+{
+	cleanup();
+}
+
+ATF_TC_WITH_CLEANUP(nfs3_pipelined_getattr);
+ATF_TC_HEAD(nfs3_pipelined_getattr, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of NFSv3 getattr RPCs "
+					"all in flight on one context");
+}
+
+ATF_TC_BODY(nfs3_pipelined_getattr, tc)
+{
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data[PIPELINE_DEPTH];
+	struct au_match matches[PIPELINE_DEPTH];
+	struct au_pipe *pipefd;
+	GETATTR3args args;
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_fh3 *fh3;
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR,
+	    &au_test_data[0]);
+	int i;
+
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
+	pipefd = setup(fds, auclass);
+	args.object = *fh3;
+	for (i = 0; i < PIPELINE_DEPTH; i++) {
+		au_rpc_init(&au_test_data[i], AUE_NFS3RPC_GETATTR);
+		au_match_init(&matches[i], AUE_NFS3RPC_GETATTR,
+		    AU_MATCH_SUCCESS);
+		ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async,
+		    nfs->rpc, nfs_res_close_cb, &args, &au_test_data[i]));
+	}
+	ATF_REQUIRE_EQ(0, nfs_wait_rpcs(nfs, au_test_data, PIPELINE_DEPTH,
+	    PIPELINE_TIMEOUT_MS));
+	for (i = 0; i < PIPELINE_DEPTH; i++) {
+		ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS,
+		    au_test_data[i].au_rpc_status);
+		ATF_REQUIRE_EQ(NFS3_OK, au_test_data[i].au_rpc_result);
+	}
+	nfs_teardown(nfs);
+	check_audit_set(fds, matches, nitems(matches), false, pipefd);
+}
+
+ATF_TC_CLEANUP(nfs3_pipelined_getattr, tc)
+{
+	cleanup();
+}
+
+ATF_TC_WITH_CLEANUP(nfs3_loop_getattr);
+ATF_TC_HEAD(nfs3_loop_getattr, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of NFSv3 getattr RPCs "
+					"on contexts serviced along with the auditpipe");
+}
+
+ATF_TC_BODY(nfs3_loop_getattr, tc)
+{
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data[LOOP_CONTEXTS];
+	struct au_match matches[LOOP_CONTEXTS];
+	bool found[LOOP_CONTEXTS];
+	struct au_pipe *pipefd;
+	GETATTR3args args;
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_context *ctx[LOOP_CONTEXTS];
+	struct nfs_pool *pool;
+	struct nfs_loop *loop;
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR,
+	    &au_test_data[0]);
+	char cwd[PATH_MAX];
+	int i;
+
+	ATF_REQUIRE(getcwd(cwd, sizeof(cwd)) != NULL);
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	args.object = *(const struct nfs_fh3 *)nfs_get_fh(nfsfh);
+
+	/* Mount every context first, mounting causes getattr records too */
+	ATF_REQUIRE((pool = nfs_pool_create(cwd, NFS_V3,
+	    LOOP_CONTEXTS)) != NULL);
+	nfs_pool_put(pool, nfs);
+	for (i = 0; i < LOOP_CONTEXTS; i++)
+		ATF_REQUIRE((ctx[i] = nfs_pool_get(pool)) != NULL);
+	pipefd = setup(fds, auclass);
+
+	ATF_REQUIRE((loop = nfs_loop_create(pipefd)) != NULL);
+	for (i = 0; i < LOOP_CONTEXTS; i++) {
+		ATF_REQUIRE_EQ(0, nfs_loop_add(loop, ctx[i]));
+		au_rpc_init(&au_test_data[i], AUE_NFS3RPC_GETATTR);
+		au_match_init(&matches[i], AUE_NFS3RPC_GETATTR,
+		    AU_MATCH_SUCCESS);
+		found[i] = false;
+		ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async,
+		    ctx[i]->rpc, nfs_res_close_cb, &args, &au_test_data[i]));
+	}
+	ATF_REQUIRE_EQ(0, nfs_loop_run(loop, au_test_data, LOOP_CONTEXTS,
+	    matches, found, LOOP_CONTEXTS, LOOP_TIMEOUT_MS));
+	for (i = 0; i < LOOP_CONTEXTS; i++) {
+		ATF_REQUIRE_EQ(NFS3_OK, au_test_data[i].au_rpc_result);
+		nfs_pool_put(pool, ctx[i]);
+	}
+	nfs_loop_destroy(loop);
+	nfs_pool_destroy(pool);
+}
+
+ATF_TC_CLEANUP(nfs3_loop_getattr, tc)
+{
+	cleanup();
+}
+
+ATF_TC_WITH_CLEANUP(nfs3_latency_stalled);
+ATF_TC_HEAD(nfs3_latency_stalled, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the latency percentiles of "
+					"NFSv3 getattr RPCs to a stalled server");
+}
+
+ATF_TC_BODY(nfs3_latency_stalled, tc)
+{
+	/* Only nfs-audit-standin stalls, the test case is skipped otherwise */
+	standin_stall(0);
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data;
+	struct rpc_latency lat;
+	GETATTR3args args;
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_fh3 *fh3;
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR,
+	    &au_test_data);
+	int i;
+
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
+	args.object = *fh3;
+	standin_stall(STALL_MS);
+	rpc_latency_reset();
+	for (i = 0; i < STALL_RPCS; i++) {
+		au_rpc_init(&au_test_data, AUE_NFS3RPC_GETATTR);
+		ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async, nfs->rpc,
+		    nfs_res_close_cb, &args, &au_test_data));
+		ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS,
+		    nfs_poll_fd(nfs, &au_test_data));
+		ATF_REQUIRE_EQ(NFS3_OK, au_test_data.au_rpc_result);
+	}
+	nfs_teardown(nfs);
+
+	/* Every reply was held back, the fastest one too */
+	ATF_REQUIRE(rpc_latency_get(AUE_NFS3RPC_GETATTR, &lat));
+	ATF_REQUIRE_EQ(STALL_RPCS, lat.count);
+	ATF_REQUIRE_EQ(0, lat.timeouts);
+	ATF_REQUIRE_MSG(lat.p50 >= (uint64_t)STALL_MS * 1000000,
+	    "p50 %ju ns is below the stall of %d ms", (uintmax_t)lat.p50,
+	    STALL_MS);
+	ATF_REQUIRE(lat.p50 <= lat.p99 && lat.p99 <= lat.p999 &&
+	    lat.p999 <= lat.max);
+}
+
+ATF_TC_CLEANUP(nfs3_latency_stalled, tc)
+{
+	cleanup();
+}
+
+ATF_TC_WITH_CLEANUP(nfs3_deadline_cancel);
+ATF_TC_HEAD(nfs3_deadline_cancel, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the cancellation of an NFSv3 "
+					"getattr RPC whose deadline passed");
+}
+
+ATF_TC_BODY(nfs3_deadline_cancel, tc)
+{
+	/* Only nfs-audit-standin stalls, the test case is skipped otherwise */
+	standin_stall(0);
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data;
+	struct rpc_latency lat;
+	GETATTR3args args;
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_fh3 *fh3;
+	struct nfs_context *nfs = tc_body_init(AUE_NFS3RPC_GETATTR,
+	    &au_test_data);
+
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	fh3 = (struct nfs_fh3 *)nfs_get_fh(nfsfh);
+	args.object = *fh3;
+	standin_stall(DEADLINE_STALL_MS);
+	rpc_latency_reset();
+	au_rpc_init(&au_test_data, AUE_NFS3RPC_GETATTR);
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs3_getattr_async, nfs->rpc,
+	    nfs_res_close_cb, &args, &au_test_data));
+
+	/* The deadline passes with the RPC still in flight */
+	ATF_REQUIRE_EQ(1, nfs_wait_rpcs(nfs, &au_test_data, 1, DEADLINE_MS));
+	ATF_REQUIRE(!au_test_data.is_finished);
+	ATF_REQUIRE_EQ(1, nfs_cancel_rpcs(nfs, &au_test_data, 1));
+	ATF_REQUIRE(au_test_data.is_finished);
+	ATF_REQUIRE_EQ(RPC_STATUS_TIMEOUT, au_test_data.au_rpc_status);
+	/* A second cancel finds nothing left in flight */
+	ATF_REQUIRE_EQ(0, nfs_cancel_rpcs(nfs, &au_test_data, 1));
+	nfs_abandon(nfs);
+
+	/* The RPC counts as a timeout, not as a latency */
+	ATF_REQUIRE(rpc_latency_get(AUE_NFS3RPC_GETATTR, &lat));
+	ATF_REQUIRE_EQ(0, lat.count);
+	ATF_REQUIRE_EQ(1, lat.timeouts);
+}
+
+ATF_TC_CLEANUP(nfs3_deadline_cancel, tc)
+{
+	cleanup();
+}
+
+ATF_TC(nfs3_ab_confidence);
+ATF_TC_HEAD(nfs3_ab_confidence, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the confidence interval of the "
+					"A/B mode of nfs-audit-bench");
+}
+
+ATF_TC_BODY(nfs3_ab_confidence, tc)
+{
+	static const double rounds[] = { 10, 12, 14 };
+	double many[40], mean, half;
+	int i;
+
+	/* Student's t for 2 degrees of freedom */
+	mean_confidence(rounds, nitems(rounds), &mean, &half);
+	ATF_REQUIRE(fabs(mean - 12) < 1e-9);
+	ATF_REQUIRE_MSG(fabs(half - 4.303 * sqrt(4.0 / 3)) < 1e-9,
+	    "half-width %f", half);
+
+	/* A single round has no interval */
+	mean_confidence(rounds, 1, &mean, &half);
+	ATF_REQUIRE(fabs(mean - 10) < 1e-9);
+	ATF_REQUIRE_EQ(0, half);
+
+	/* Past the table, the normal quantile */
+	for (i = 0; i < (int)nitems(many); i++)
+		many[i] = i % 2 == 0 ? 0 : 2;
+	mean_confidence(many, nitems(many), &mean, &half);
+	ATF_REQUIRE(fabs(mean - 1) < 1e-9);
+	ATF_REQUIRE_MSG(fabs(half - 1.96 * sqrt(40.0 / 39 / 40)) < 1e-9,
+	    "half-width %f", half);
+}
+
 ATF_TP_ADD_TCS(tp)
 {
 	ATF_TP_ADD_TC(tp, nfs3_getattr_success);
@@ -1548,6 +1999,12 @@ ATF_TP_ADD_TCS(tp)
 	ATF_TP_ADD_TC(tp, nfs3_pathconf_failure);
 	ATF_TP_ADD_TC(tp, nfs3_commit_success);
 	ATF_TP_ADD_TC(tp, nfs3_commit_failure);
+	ATF_TP_ADD_TC(tp, nfs3_pool_reuse);
+	ATF_TP_ADD_TC(tp, nfs3_pipelined_getattr);
+	ATF_TP_ADD_TC(tp, nfs3_loop_getattr);
+	ATF_TP_ADD_TC(tp, nfs3_latency_stalled);
+	ATF_TP_ADD_TC(tp, nfs3_deadline_cancel);
+	ATF_TP_ADD_TC(tp, nfs3_ab_confidence);
 
 	return (atf_no_error());
 }
@@ -16,6 +16,7 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -46,22 +47,26 @@ static char path[] = "fileforaudit";
 //static const char *successreg = "fileforaudit.*return,success";
 //static const char *failurereg = "fileforaudit.*return,failure";
 
-#define NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, IsSuccess)	\
+#define NFS4_COMMON_PERFORM(i, op, event, nfs, au_test_data, IsSuccess,	\
+    status, text)							\
 do {									\
-	FILE *pipefd = setup(fds, auclass);				\
+	struct au_pipe *pipefd = setup(fds, auclass);			\
+	struct au_match match;						\
 	COMPOUND4args args;						\
 	memset(&args, 0, sizeof(args));					\
 	args.argarray.argarray_len = (i);				\
 	args.argarray.argarray_val = (op);				\
-	ATF_REQUIRE_EQ(0, rpc_nfs4_compound_async((nfs)->rpc,		\
-	    (rpc_cb)nfsv4_res_close_cb, &args, &(au_test_data)));	\
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs4_compound_async,		\
+	    (nfs)->rpc, nfsv4_res_close_cb, &args, &(au_test_data)));	\
 	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS,				\
 	    nfs_poll_fd((nfs), &(au_test_data)));			\
 	if (IsSuccess)							\
 		ATF_REQUIRE_EQ(NFS4_OK, (au_test_data).au_rpc_result);	\
 	else								\
 		ATF_REQUIRE(NFS4_OK != (au_test_data).au_rpc_result);	\
-	check_audit(fds, (regex), pipefd);				\
+	au_match_init(&match, (event), (status));			\
+	match.text = (text);						\
+	check_audit_match(fds, &match, pipefd);				\
 } while (0)
 
 static int
@@ -570,12 +575,13 @@ ATF_TC_HEAD(nfs4_compound_rpc, tc)
 
 ATF_TC_BODY(nfs4_compound_rpc, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_ACCESS, &au_test_data);
-	const char *regex = "nfsrvd_compound.*return,success";
 
-	NFS4_COMMON_PERFORM(0, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(0, op, AUE_NFSV4RPC_COMPOUND, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_compound_rpc, tc)
@@ -583,6 +589,50 @@ ATF_TC_CLEANUP(nfs4_compound_rpc, tc)
 	cleanup();
 }
 
+ATF_TC_WITH_CLEANUP(nfs4_compound_subops);
+ATF_TC_HEAD(nfs4_compound_subops, tc)
+{
+	atf_tc_set_md_var(tc, "descr", "Tests the audit of an NFSv4 Compound "
+					"RPC along with all its sub-ops");
+}
+
+ATF_TC_BODY(nfs4_compound_subops, tc)
+{
+	tc_workdir();
+	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
+
+	struct au_rpc_data au_test_data;
+	struct au_match matches[3];
+	struct au_pipe *pipefd;
+	COMPOUND4args args;
+	int i;
+	nfs_argop4 op[2];
+	struct nfsfh *nfsfh = NULL;
+	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_ACCESS, &au_test_data);
+
+	au_match_init(&matches[0], AUE_NFSV4RPC_COMPOUND, AU_MATCH_SUCCESS);
+	au_match_init(&matches[1], AUE_NFSV4OP_PUTFH, AU_MATCH_SUCCESS);
+	au_match_init(&matches[2], AUE_NFSV4OP_ACCESS, AU_MATCH_SUCCESS);
+
+	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
+	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
+	i += nfs4_op_access(nfs, &op[i], ACCESS4_READ);
+	pipefd = setup(fds, auclass);
+	memset(&args, 0, sizeof(args));
+	args.argarray.argarray_len = i;
+	args.argarray.argarray_val = op;
+	ATF_REQUIRE_EQ(0, AU_RPC_ASYNC(rpc_nfs4_compound_async, nfs->rpc,
+	    nfsv4_res_close_cb, &args, &au_test_data));
+	ATF_REQUIRE_EQ(RPC_STATUS_SUCCESS, nfs_poll_fd(nfs, &au_test_data));
+	ATF_REQUIRE_EQ(NFS4_OK, au_test_data.au_rpc_result);
+	check_audit_set(fds, matches, nitems(matches), false, pipefd);
+}
+
+ATF_TC_CLEANUP(nfs4_compound_subops, tc)
+{
+	cleanup();
+}
+
 ATF_TC_WITH_CLEANUP(nfs4_access_success);
 ATF_TC_HEAD(nfs4_access_success, tc)
 {
@@ -592,6 +642,7 @@ ATF_TC_HEAD(nfs4_access_success, tc)
 
 ATF_TC_BODY(nfs4_access_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -599,12 +650,12 @@ ATF_TC_BODY(nfs4_access_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_ACCESS, &au_test_data);
-	const char *regex = "nfsrvd_access.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_access(nfs, &op[i], ACCESS4_READ);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_ACCESS, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_access_success, tc)
@@ -621,15 +672,16 @@ ATF_TC_HEAD(nfs4_access_failure, tc)
 
 ATF_TC_BODY(nfs4_access_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_ACCESS, &au_test_data);
-	const char *regex = "nfsrvd_access.*return,failure";
 
 	/* NFSv4 ACCESS sub-operation will fail due to invalid use. (no PUTFH subop) */
 	i = nfs4_op_access(nfs, &op[0], ACCESS4_DELETE);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_ACCESS, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_access_failure, tc)
@@ -646,6 +698,7 @@ ATF_TC_HEAD(nfs4_close_success, tc)
 
 ATF_TC_BODY(nfs4_close_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -653,12 +706,12 @@ ATF_TC_BODY(nfs4_close_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_CLOSE, &au_test_data);
-	const char *regex = "nfsrvd_close.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_close(nfs, &op[i], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_CLOSE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_close_success, tc)
@@ -675,6 +728,7 @@ ATF_TC_HEAD(nfs4_close_failure, tc)
 
 ATF_TC_BODY(nfs4_close_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -682,13 +736,13 @@ ATF_TC_BODY(nfs4_close_failure, tc)
 	nfs_argop4 op[1];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_CLOSE, &au_test_data);
-	const char *regex = "nfsrvd_close.*return,failure";
 
 	/* File removed before making sub-op call, stale file handle. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	ATF_REQUIRE_EQ(0, remove(path));
 	i = nfs4_op_close(nfs, &op[0], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_CLOSE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_close_failure, tc)
@@ -705,6 +759,7 @@ ATF_TC_HEAD(nfs4_commit_success, tc)
 
 ATF_TC_BODY(nfs4_commit_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -712,12 +767,12 @@ ATF_TC_BODY(nfs4_commit_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_COMMIT, &au_test_data);
-	const char *regex = "nfsrvd_commit.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_commit(nfs, &op[i]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_COMMIT, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_commit_success, tc)
@@ -734,15 +789,16 @@ ATF_TC_HEAD(nfs4_commit_failure, tc)
 
 ATF_TC_BODY(nfs4_commit_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_COMMIT, &au_test_data);
-	const char *regex = "nfsrvd_commit.*return,failure";
 
 	/* NFSv4 COMMIT sub-operation will fail due to invalid use. (no PUTFH subop) */
 	i = nfs4_op_commit(nfs, &op[0]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_COMMIT, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_commit_failure, tc)
@@ -759,18 +815,19 @@ ATF_TC_HEAD(nfs4_create_success, tc)
 
 ATF_TC_BODY(nfs4_create_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	nfs_argop4 op[2];
 	int i;
 	struct nfsfh nfsfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_CREATE, &au_test_data);
-	const char *regex = "nfsrvd_mknod.*return,success";
 
 	nfsfh.fh.len = nfs->rootfh.len;
 	nfsfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &nfsfh);
 	i += nfs4_op_create_char(nfs, &op[i]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_CREATE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_create_success, tc)
@@ -787,12 +844,12 @@ ATF_TC_HEAD(nfs4_create_failure, tc)
 
 ATF_TC_BODY(nfs4_create_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	nfs_argop4 op[2];
 	int i;
 	struct nfsfh nfsfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_CREATE, &au_test_data);
-	const char *regex = "nfsrvd_mknod.*return,failure";
 
 	/* Results in error: File exists. */
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
@@ -800,7 +857,8 @@ ATF_TC_BODY(nfs4_create_failure, tc)
 	nfsfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &nfsfh);
 	i += nfs4_op_create_char(nfs, &op[i]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_CREATE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_create_failure, tc)
@@ -817,14 +875,15 @@ ATF_TC_HEAD(nfs4_delegpurge_success, tc)
 
 ATF_TC_BODY(nfs4_delegpurge_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_DELEGPURGE, &au_test_data);
-	const char *regex = "nfsrvd_delegpurge.*return,success";
 
 	i = nfs4_op_delepurge(nfs, &op[0]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_DELEGPURGE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_delegpurge_success, tc)
@@ -841,16 +900,17 @@ ATF_TC_HEAD(nfs4_delegpurge_failure, tc)
 
 ATF_TC_BODY(nfs4_delegpurge_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_DELEGPURGE, &au_test_data);
-	const char *regex = "nfsrvd_delegpurge.*return,failure";
 
 	/* Invalid argument set for NFSv4 Client Id, resulting in failure. */ 
 	nfs->clientid = 0;
 	i = nfs4_op_delepurge(nfs, &op[0]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_DELEGPURGE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_delegpurge_failure, tc)
@@ -867,6 +927,7 @@ ATF_TC_HEAD(nfs4_delegreturn_success, tc)
 
 ATF_TC_BODY(nfs4_delegreturn_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -874,12 +935,12 @@ ATF_TC_BODY(nfs4_delegreturn_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_DELEGRETURN, &au_test_data);
-	const char *regex = "nfsrvd_delegreturn.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_delegreturn(nfs, &op[i], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_DELEGRETURN, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_delegreturn_success, tc)
@@ -896,6 +957,7 @@ ATF_TC_HEAD(nfs4_delegreturn_failure, tc)
 
 ATF_TC_BODY(nfs4_delegreturn_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -903,11 +965,11 @@ ATF_TC_BODY(nfs4_delegreturn_failure, tc)
 	nfs_argop4 op[1];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_DELEGRETURN, &au_test_data);
-	const char *regex = "nfsrvd_delegreturn.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_delegreturn(nfs, &op[0], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_DELEGRETURN, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_delegreturn_failure, tc)
@@ -924,6 +986,7 @@ ATF_TC_HEAD(nfs4_getattr_success, tc)
 
 ATF_TC_BODY(nfs4_getattr_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -931,12 +994,12 @@ ATF_TC_BODY(nfs4_getattr_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_GETATTR, &au_test_data);
-	const char *regex = "nfsrvd_getattr.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_getattr(nfs, &op[i], standard_attributes, 2);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_GETATTR, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_getattr_success, tc)
@@ -953,15 +1016,16 @@ ATF_TC_HEAD(nfs4_getattr_failure, tc)
 
 ATF_TC_BODY(nfs4_getattr_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_GETATTR, &au_test_data);
-	const char *regex = "nfsrvd_getattr.*return,failure";
 
 	/* NFSv4 GETATTR sub-operation will fail due to invalid use. (no PUTFH subop) */
 	i = nfs4_op_getattr(nfs, &op[0], standard_attributes, 2);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_GETATTR, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_getattr_failure, tc)
@@ -978,6 +1042,7 @@ ATF_TC_HEAD(nfs4_getfh_success, tc)
 
 ATF_TC_BODY(nfs4_getfh_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -985,12 +1050,12 @@ ATF_TC_BODY(nfs4_getfh_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_GETFH, &au_test_data);
-	const char *regex = "nfsrvd_getfh.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_getfh(nfs, &op[i]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_GETFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_getfh_success, tc)
@@ -1007,15 +1072,16 @@ ATF_TC_HEAD(nfs4_getfh_failure, tc)
 
 ATF_TC_BODY(nfs4_getfh_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_GETFH, &au_test_data);
-	const char *regex = "nfsrvd_getfh.*return,failure";
 
 	/* NFSv4 GETFH sub-operation will fail due to invalid use. (no PUTFH subop) */
 	i = nfs4_op_getfh(nfs, &op[0]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_GETFH, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_getfh_failure, tc)
@@ -1032,6 +1098,7 @@ ATF_TC_HEAD(nfs4_link_success, tc)
 
 ATF_TC_BODY(nfs4_link_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open("ATestFile", O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1040,7 +1107,6 @@ ATF_TC_BODY(nfs4_link_success, tc)
 	struct nfsfh dirfh;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LINK, &au_test_data);
-	const char *regex = "nfsrvd_link.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, "ATestFile", O_RDONLY, &nfsfh));
 
@@ -1050,7 +1116,8 @@ ATF_TC_BODY(nfs4_link_success, tc)
 	i += nfs4_op_savefh(nfs, &op[i]);
 	i += nfs4_op_putfh(nfs, &op[i], &dirfh);
 	i += nfs4_op_link(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LINK, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_link_success, tc)
@@ -1067,6 +1134,7 @@ ATF_TC_HEAD(nfs4_link_failure, tc)
 
 ATF_TC_BODY(nfs4_link_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open("ATestFile", O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1075,7 +1143,6 @@ ATF_TC_BODY(nfs4_link_failure, tc)
 	struct nfsfh dirfh;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LINK, &au_test_data);
-	const char *regex = "nfsrvd_link.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, "ATestFile", O_RDONLY, &nfsfh));
 	/* To result in error: File exists. */
@@ -1086,7 +1153,8 @@ ATF_TC_BODY(nfs4_link_failure, tc)
 	i += nfs4_op_savefh(nfs, &op[i]);
 	i += nfs4_op_putfh(nfs, &op[i], &dirfh);
 	i += nfs4_op_link(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LINK, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_link_failure, tc)
@@ -1103,6 +1171,7 @@ ATF_TC_HEAD(nfs4_lock_success, tc)
 
 ATF_TC_BODY(nfs4_lock_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1110,12 +1179,12 @@ ATF_TC_BODY(nfs4_lock_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCK, &au_test_data);
-	const char *regex = "nfsrvd_lock.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_lock(nfs, &op[i], nfsfh, OP_LOCK, WRITEW_LT, 0, 0, 1);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCK, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lock_success, tc)
@@ -1132,6 +1201,7 @@ ATF_TC_HEAD(nfs4_lock_failure, tc)
 
 ATF_TC_BODY(nfs4_lock_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1139,13 +1209,13 @@ ATF_TC_BODY(nfs4_lock_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCK, &au_test_data);
-	const char *regex = "nfsrvd_lock.*return,failure";
 
 	/* Invalid argument: length == 0 in lock args result in error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_lock(nfs, &op[i], nfsfh, OP_LOCK, WRITEW_LT, 0, 0, 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCK, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lock_failure, tc)
@@ -1162,6 +1232,7 @@ ATF_TC_HEAD(nfs4_lockt_success, tc)
 
 ATF_TC_BODY(nfs4_lockt_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1169,12 +1240,12 @@ ATF_TC_BODY(nfs4_lockt_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCKT, &au_test_data);
-	const char *regex = "nfsrvd_lockt.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_lockt(nfs, &op[i], nfsfh, WRITEW_LT, 0, 1);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCKT, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lockt_success, tc)
@@ -1191,6 +1262,7 @@ ATF_TC_HEAD(nfs4_lockt_failure, tc)
 
 ATF_TC_BODY(nfs4_lockt_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1198,13 +1270,13 @@ ATF_TC_BODY(nfs4_lockt_failure, tc)
 	nfs_argop4 op[3];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCKT, &au_test_data);
-	const char *regex = "nfsrvd_lockt.*return,failure";
 
 	/* Invalid argument: length == 0 in lockt args result in error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_lockt(nfs, &op[i], nfsfh, WRITEW_LT, 0, 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCKT, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lockt_failure, tc)
@@ -1221,6 +1293,7 @@ ATF_TC_HEAD(nfs4_locku_success, tc)
 
 ATF_TC_BODY(nfs4_locku_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1228,13 +1301,13 @@ ATF_TC_BODY(nfs4_locku_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCKU, &au_test_data);
-	const char *regex = "nfsrvd_locku.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	ATF_REQUIRE_EQ(0, nfs_lockf(nfs, nfsfh, NFS4_F_LOCK, 1));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_locku(nfs, &op[i], nfsfh, READW_LT, 0, 1);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCKU, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_locku_success, tc)
@@ -1251,6 +1324,7 @@ ATF_TC_HEAD(nfs4_locku_failure, tc)
 
 ATF_TC_BODY(nfs4_locku_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1258,12 +1332,12 @@ ATF_TC_BODY(nfs4_locku_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOCKU, &au_test_data);
-	const char *regex = "nfsrvd_locku.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_locku(nfs, &op[i], nfsfh, READW_LT, 0, 1);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOCKU, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_locku_failure, tc)
@@ -1280,6 +1354,7 @@ ATF_TC_HEAD(nfs4_lookup_success, tc)
 
 ATF_TC_BODY(nfs4_lookup_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1287,13 +1362,13 @@ ATF_TC_BODY(nfs4_lookup_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOOKUP, &au_test_data);
-	const char *regex = "nfsrvd_lookup.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_lookup(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOOKUP, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lookup_success, tc)
@@ -1310,19 +1385,20 @@ ATF_TC_HEAD(nfs4_lookup_failure, tc)
 
 ATF_TC_BODY(nfs4_lookup_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOOKUP, &au_test_data);
-	const char *regex = "nfsrvd_lookup.*return,failure";
 
 	/* No such file or directory with name fileforaudit. */
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_lookup(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOOKUP, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lookup_failure, tc)
@@ -1339,6 +1415,7 @@ ATF_TC_HEAD(nfs4_lookupp_success, tc)
 
 ATF_TC_BODY(nfs4_lookupp_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1346,13 +1423,13 @@ ATF_TC_BODY(nfs4_lookupp_success, tc)
 	nfs_argop4 op[3];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOOKUPP, &au_test_data);
-	const char *regex = "nfsrvd_lookup.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	op[i++].argop = OP_LOOKUPP;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOOKUPP, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lookupp_success, tc)
@@ -1369,18 +1446,19 @@ ATF_TC_HEAD(nfs4_lookupp_failure, tc)
 
 ATF_TC_BODY(nfs4_lookupp_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_LOOKUPP, &au_test_data);
-	const char *regex = "nfsrvd_lookup.*return,failure";
 
 	/* It fails since no file handle given (PUTFH OP). */
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	op[i++].argop = OP_LOOKUPP;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_LOOKUPP, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_lookupp_failure, tc)
@@ -1397,6 +1475,7 @@ ATF_TC_HEAD(nfs4_nverify_success, tc)
 
 ATF_TC_BODY(nfs4_nverify_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1405,13 +1484,13 @@ ATF_TC_BODY(nfs4_nverify_success, tc)
 	struct nfsfh *nfsfh = NULL;
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_NVERIFY, &au_test_data);
-	const char *regex = "nfsrvd_verify.*return,success";
 
 	m = htonl(m);
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_nverify_chmod(nfs, &op[i], &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_NVERIFY, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_nverify_success, tc)
@@ -1428,17 +1507,18 @@ ATF_TC_HEAD(nfs4_nverify_failure, tc)
 
 ATF_TC_BODY(nfs4_nverify_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_NVERIFY, &au_test_data);
-	const char *regex = "nfsrvd_verify.*return,failure";
 
 	/* NFSv4 NVERIFY sub-operation will fail due to invalid use. (no PUTFH subop) */
 	m = htonl(m);
 	i = nfs4_op_nverify_chmod(nfs, &op[0], &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_NVERIFY, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_nverify_failure, tc)
@@ -1455,6 +1535,7 @@ ATF_TC_HEAD(nfs4_open_success, tc)
 
 ATF_TC_BODY(nfs4_open_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1462,13 +1543,13 @@ ATF_TC_BODY(nfs4_open_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPEN, &au_test_data);
-	const char *regex = "nfsrvd_open.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_open(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPEN, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_open_success, tc)
@@ -1485,19 +1566,20 @@ ATF_TC_HEAD(nfs4_open_failure, tc)
 
 ATF_TC_BODY(nfs4_open_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPEN, &au_test_data);
-	const char *regex = "nfsrvd_open.*return,failure";
 
 	/* Open type is OPEN4_NOCREATE and no file exists with name path. */
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_open(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPEN, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_open_failure, tc)
@@ -1514,6 +1596,7 @@ ATF_TC_HEAD(nfs4_openattr_failure, tc)
 
 ATF_TC_BODY(nfs4_openattr_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1521,7 +1604,6 @@ ATF_TC_BODY(nfs4_openattr_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPENATTR, &au_test_data);
-	const char *regex = "nfsrvd_openattr.*text,NFSv4 service not supported";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
@@ -1531,7 +1613,10 @@ ATF_TC_BODY(nfs4_openattr_failure, tc)
 	memset(oaargs, 0, sizeof(*oaargs));
 	op[i++].argop = OP_OPENATTR;
 	oaargs->createdir = true;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+
+	/* The record names the reason the sub-op was refused in its text */
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPENATTR, nfs, au_test_data,
+	    false, AU_MATCH_ANY, "NFSv4 service not supported");
 }
 
 ATF_TC_CLEANUP(nfs4_openattr_failure, tc)
@@ -1548,17 +1633,19 @@ ATF_TC_HEAD(nfs4_openconfirm_success, tc)
 
 ATF_TC_BODY(nfs4_openconfirm_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPENCONFIRM, &au_test_data);
-	const char *regex = "nfsrvd_openconfirm.*return,success";
-	FILE *pipefd = setup(fds, auclass);
+	struct au_pipe *pipefd = setup(fds, auclass);
 
 	/* openconfirm subop is made just after open subop in nfs_open. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
-	check_audit(fds, (regex), pipefd);
+	au_match_init(&match, AUE_NFSV4OP_OPENCONFIRM, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs4_openconfirm_success, tc)
@@ -1575,6 +1662,7 @@ ATF_TC_HEAD(nfs4_openconfirm_failure, tc)
 
 ATF_TC_BODY(nfs4_openconfirm_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1582,12 +1670,12 @@ ATF_TC_BODY(nfs4_openconfirm_failure, tc)
 	nfs_argop4 op[1];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPENCONFIRM, &au_test_data);
-	const char *regex = "nfsrvd_openconfirm.*return,failure";
 
 	/* Invalid use of open_confirm operation. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_open_confirm(nfs, &op[0], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPENCONFIRM, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_openconfirm_failure, tc)
@@ -1604,6 +1692,7 @@ ATF_TC_HEAD(nfs4_opendowngrade_success, tc)
 
 ATF_TC_BODY(nfs4_opendowngrade_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1611,13 +1700,13 @@ ATF_TC_BODY(nfs4_opendowngrade_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPENDOWNGRADE, &au_test_data);
-	const char *regex = "nfsrvd_opendowngrade.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_open_downgrade(nfs, &op[i], nfsfh,
 	    OPEN4_SHARE_ACCESS_READ, OPEN4_SHARE_DENY_NONE);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPENDOWNGRADE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_opendowngrade_success, tc)
@@ -1634,6 +1723,7 @@ ATF_TC_HEAD(nfs4_opendowngrade_failure, tc)
 
 ATF_TC_BODY(nfs4_opendowngrade_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1641,7 +1731,6 @@ ATF_TC_BODY(nfs4_opendowngrade_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_OPENDOWNGRADE, &au_test_data);
-	const char *regex = "nfsrvd_opendowngrade.*return,failure";
 
 	/* Due to lock being held, the operation fails with NFS4ERR_LOCKS_HELD error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
@@ -1649,7 +1738,8 @@ ATF_TC_BODY(nfs4_opendowngrade_failure, tc)
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_open_downgrade(nfs, &op[i], nfsfh,
 	    OPEN4_SHARE_ACCESS_READ, OPEN4_SHARE_DENY_NONE);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_OPENDOWNGRADE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_opendowngrade_failure, tc)
@@ -1666,6 +1756,7 @@ ATF_TC_HEAD(nfs4_putfh_success, tc)
 
 ATF_TC_BODY(nfs4_putfh_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1673,11 +1764,11 @@ ATF_TC_BODY(nfs4_putfh_success, tc)
 	nfs_argop4 op[1];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_PUTFH, &au_test_data);
-	const char *regex = "NFSV4OP_PUTFH.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_PUTFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_putfh_success, tc)
@@ -1694,6 +1785,7 @@ ATF_TC_HEAD(nfs4_putfh_failure, tc)
 
 ATF_TC_BODY(nfs4_putfh_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1701,13 +1793,13 @@ ATF_TC_BODY(nfs4_putfh_failure, tc)
 	nfs_argop4 op[1];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_PUTFH, &au_test_data);
-	const char *regex = "NFSV4OP_PUTFH.*return,failure";
 
 	/* PUTH OP fails due to Stale NFS file handle error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	ATF_REQUIRE_EQ(0, remove(path));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_PUTFH, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_putfh_failure, tc)
@@ -1724,6 +1816,7 @@ ATF_TC_HEAD(nfs4_putpubfh_success, tc)
 
 ATF_TC_BODY(nfs4_putpubfh_success, tc)
 {
+	tc_workdir();
 	/*
 	 * XXX: https://tools.ietf.org/html/rfc5661#section-18.20
 	 * but How to use this operation correctly??
@@ -1732,10 +1825,10 @@ ATF_TC_BODY(nfs4_putpubfh_success, tc)
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_PUTPUBFH, &au_test_data);
-	const char *regex = "NFSV4OP_PUTPUBFH.*return,success";
 
 	op[i++].argop = OP_PUTPUBFH;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_PUTPUBFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_putpubfh_success, tc)
@@ -1752,14 +1845,15 @@ ATF_TC_HEAD(nfs4_putpubfh_failure, tc)
 
 ATF_TC_BODY(nfs4_putpubfh_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_PUTPUBFH, &au_test_data);
-	const char *regex = "NFSV4OP_PUTPUBFH.*return,failure";
 
 	op[i++].argop = OP_PUTPUBFH;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_PUTPUBFH, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_putpubfh_failure, tc)
@@ -1776,14 +1870,15 @@ ATF_TC_HEAD(nfs4_putrootfh_success, tc)
 
 ATF_TC_BODY(nfs4_putrootfh_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_PUTROOTFH, &au_test_data);
-	const char *regex = "NFSV4OP_PUTROOTFH.*return,success";
 
 	op[i++].argop = OP_PUTROOTFH;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_PUTROOTFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_putrootfh_success, tc)
@@ -1800,6 +1895,7 @@ ATF_TC_HEAD(nfs4_read_success, tc)
 
 ATF_TC_BODY(nfs4_read_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1807,12 +1903,12 @@ ATF_TC_BODY(nfs4_read_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READ, &au_test_data);
-	const char *regex = "nfsrvd_read.*return,success";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_read(nfs, &op[i], nfsfh, 0, 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_READ, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_read_success, tc)
@@ -1829,6 +1925,7 @@ ATF_TC_HEAD(nfs4_read_failure, tc)
 
 ATF_TC_BODY(nfs4_read_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1836,13 +1933,13 @@ ATF_TC_BODY(nfs4_read_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READ, &au_test_data);
-	const char *regex = "nfsrvd_read.*return,failure";
 
 	/* Invalid FH for READ op, since it is directory. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	op[i++].argop = OP_PUTROOTFH;
 	i += nfs4_op_read(nfs, &op[i], nfsfh, 0, 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_READ, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_read_failure, tc)
@@ -1859,18 +1956,19 @@ ATF_TC_HEAD(nfs4_readdir_success, tc)
 
 ATF_TC_BODY(nfs4_readdir_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READDIR, &au_test_data);
-	const char *regex = "nfsrvd_readdirplus.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_readdir(nfs, &op[i], 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_READDIR, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_readdir_success, tc)
@@ -1887,17 +1985,18 @@ ATF_TC_HEAD(nfs4_readdir_failure, tc)
 
 ATF_TC_BODY(nfs4_readdir_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READDIR, &au_test_data);
-	const char *regex = "nfsrvd_readdirplus.*return,failure";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_CREAT, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_readdir(nfs, &op[i], 0);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_READDIR, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_readdir_failure, tc)
@@ -1914,19 +2013,21 @@ ATF_TC_HEAD(nfs4_readlink_success, tc)
 
 ATF_TC_BODY(nfs4_readlink_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE_EQ(0, symlink(path, "symlink"));
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	char buf[PATH_MAX];
-	FILE* pipefd;
+	struct au_pipe *pipefd;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READLINK, &au_test_data);
-	const char *regex = "nfsrvd_readlink.*return,success";
 
 	/* XXX: used high-level API here to avoid the code complications. */ 
 	pipefd = setup(fds, auclass);
 	ATF_REQUIRE_EQ(0, nfs_readlink(nfs, "symlink", buf, sizeof(buf)));
 	ATF_REQUIRE_MATCH(buf, path);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFSV4OP_READLINK, AU_MATCH_SUCCESS);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs4_readlink_success, tc)
@@ -1943,19 +2044,21 @@ ATF_TC_HEAD(nfs4_readlink_failure, tc)
 
 ATF_TC_BODY(nfs4_readlink_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
+	struct au_match match;
 	char buf[PATH_MAX];
-	FILE* pipefd;
+	struct au_pipe *pipefd;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_READLINK, &au_test_data);
-	const char *regex = "nfsrvd_readlink.*return,failure";
 
 	/* XXX: used high-level API here to avoid the code complications. */
 	/* path is a regular file and not symlink. */
 	pipefd = setup(fds, auclass);
 	ATF_REQUIRE(nfs_readlink(nfs, path, buf, sizeof(buf)) != 0);
-	check_audit(fds, regex, pipefd);
+	au_match_init(&match, AUE_NFSV4OP_READLINK, AU_MATCH_FAILURE);
+	check_audit_match(fds, &match, pipefd);
 }
 
 ATF_TC_CLEANUP(nfs4_readlink_failure, tc)
@@ -1972,6 +2075,7 @@ ATF_TC_HEAD(nfs4_remove_success, tc)
 
 ATF_TC_BODY(nfs4_remove_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -1979,13 +2083,13 @@ ATF_TC_BODY(nfs4_remove_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_REMOVE, &au_test_data);
-	const char *regex = "nfsrvd_remove.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);	
 	i += nfs4_op_remove(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_REMOVE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_remove_success, tc)
@@ -2002,19 +2106,20 @@ ATF_TC_HEAD(nfs4_remove_failure, tc)
 
 ATF_TC_BODY(nfs4_remove_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_REMOVE, &au_test_data);
-	const char *regex = "nfsrvd_remove.*return,failure";
 
 	/* No file or directory exists with name path. */
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_remove(nfs, &op[i], path);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_REMOVE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_remove_failure, tc)
@@ -2031,6 +2136,7 @@ ATF_TC_HEAD(nfs4_rename_success, tc)
 
 ATF_TC_BODY(nfs4_rename_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2038,7 +2144,6 @@ ATF_TC_BODY(nfs4_rename_success, tc)
 	nfs_argop4 op[4];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RENAME, &au_test_data);
-	const char *regex = "nfsrvd_rename.*return,success";
 	char newpath[] = "new_fileforaudit";
 
 	dirfh.fh.len = nfs->rootfh.len;
@@ -2047,7 +2152,8 @@ ATF_TC_BODY(nfs4_rename_success, tc)
 	i += nfs4_op_savefh(nfs, &op[i]);
 	i += nfs4_op_putfh(nfs, &op[i], &dirfh);	
 	i += nfs4_op_rename(nfs, &op[i], path, newpath);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RENAME, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_rename_success, tc)
@@ -2064,12 +2170,12 @@ ATF_TC_HEAD(nfs4_rename_failure, tc)
 
 ATF_TC_BODY(nfs4_rename_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[4];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RENAME, &au_test_data);
-	const char *regex = "nfsrvd_rename.*return,failure";
 	char newpath[] = "new_fileforaudit";
 
 	/* No such file or directory with name path. */
@@ -2079,7 +2185,8 @@ ATF_TC_BODY(nfs4_rename_failure, tc)
 	i += nfs4_op_savefh(nfs, &op[i]);
 	i += nfs4_op_putfh(nfs, &op[i], &dirfh);	
 	i += nfs4_op_rename(nfs, &op[i], path, newpath);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RENAME, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_rename_failure, tc)
@@ -2096,14 +2203,15 @@ ATF_TC_HEAD(nfs4_renew_success, tc)
 
 ATF_TC_BODY(nfs4_renew_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RENEW, &au_test_data);
-	const char *regex = "nfsrvd_renew.*return,success";
 
 	op[0].argop = OP_RENEW;
 	op[0].nfs_argop4_u.oprenew.clientid = nfs->clientid;
-	NFS4_COMMON_PERFORM(1, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(1, op, AUE_NFSV4OP_RENEW, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_renew_success, tc)
@@ -2120,15 +2228,16 @@ ATF_TC_HEAD(nfs4_renew_failure, tc)
 
 ATF_TC_BODY(nfs4_renew_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RENEW, &au_test_data);
-	const char *regex = "nfsrvd_renew.*return,failure";
 
 	/* put a random client id (invalid). */
 	op[0].argop = OP_RENEW;
 	op[0].nfs_argop4_u.oprenew.clientid = 12345;
-	NFS4_COMMON_PERFORM(1, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(1, op, AUE_NFSV4OP_RENEW, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_renew_failure, tc)
@@ -2145,19 +2254,20 @@ ATF_TC_HEAD(nfs4_restorefh_success, tc)
 
 ATF_TC_BODY(nfs4_restorefh_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[3];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RESTOREFH, &au_test_data);
-	const char *regex = "NFSV4OP_RESTOREFH.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_savefh(nfs, &op[i]);
 	op[i++].argop = OP_RESTOREFH;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RESTOREFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_restorefh_success, tc)
@@ -2174,19 +2284,20 @@ ATF_TC_HEAD(nfs4_restorefh_failure, tc)
 
 ATF_TC_BODY(nfs4_restorefh_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RESTOREFH, &au_test_data);
-	const char *regex = "NFSV4OP_RESTOREFH.*return,failure";
 
 	/* No saved filehandle, OP would result in NFS4ERR_NOFILEHANDLE. */
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	op[i++].argop = OP_RESTOREFH;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RESTOREFH, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_restorefh_failure, tc)
@@ -2203,18 +2314,19 @@ ATF_TC_HEAD(nfs4_savefh_success, tc)
 
 ATF_TC_BODY(nfs4_savefh_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SAVEFH, &au_test_data);
-	const char *regex = "NFSV4OP_SAVEFH.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
 	i = nfs4_op_putfh(nfs, &op[0], &dirfh);
 	i += nfs4_op_savefh(nfs, &op[i]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SAVEFH, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_savefh_success, tc)
@@ -2231,15 +2343,16 @@ ATF_TC_HEAD(nfs4_savefh_failure, tc)
 
 ATF_TC_BODY(nfs4_savefh_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SAVEFH, &au_test_data);
-	const char *regex = "NFSV4OP_SAVEFH.*return,failure";
 
 	/* No filehandle to save, OP would result in error. */
 	i = nfs4_op_savefh(nfs, &op[0]);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SAVEFH, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_savefh_failure, tc)
@@ -2256,6 +2369,7 @@ ATF_TC_HEAD(nfs4_secinfo_success, tc)
 
 ATF_TC_BODY(nfs4_secinfo_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2263,7 +2377,6 @@ ATF_TC_BODY(nfs4_secinfo_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SECINFO, &au_test_data);
-	const char *regex = "nfsrvd_secinfo.*return,success";
 
 	dirfh.fh.len = nfs->rootfh.len;
 	dirfh.fh.val = nfs->rootfh.val;
@@ -2271,7 +2384,8 @@ ATF_TC_BODY(nfs4_secinfo_success, tc)
 	op[i].argop = OP_SECINFO;
 	op[i].nfs_argop4_u.opsecinfo.name.utf8string_len = strlen(path);
 	op[i++].nfs_argop4_u.opsecinfo.name.utf8string_val = path;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SECINFO, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_secinfo_success, tc)
@@ -2288,12 +2402,12 @@ ATF_TC_HEAD(nfs4_secinfo_failure, tc)
 
 ATF_TC_BODY(nfs4_secinfo_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[2];
 	struct nfsfh dirfh;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SECINFO, &au_test_data);
-	const char *regex = "nfsrvd_secinfo.*return,failure";
 
 	/* No such file or directory with name path. */
 	dirfh.fh.len = nfs->rootfh.len;
@@ -2302,7 +2416,8 @@ ATF_TC_BODY(nfs4_secinfo_failure, tc)
 	op[i].argop = OP_SECINFO;
 	op[i].nfs_argop4_u.opsecinfo.name.utf8string_len = strlen(path);
 	op[i++].nfs_argop4_u.opsecinfo.name.utf8string_val = path;
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SECINFO, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_secinfo_failure, tc)
@@ -2319,6 +2434,7 @@ ATF_TC_HEAD(nfs4_setattr_success, tc)
 
 ATF_TC_BODY(nfs4_setattr_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2327,13 +2443,13 @@ ATF_TC_BODY(nfs4_setattr_success, tc)
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SETATTR, &au_test_data);
-	const char *regex = "nfsrvd_setattr.*return,success";
 
 	m = htonl(m);
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_setattr_chmod(nfs, &op[i], nfsfh, &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SETATTR, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_setattr_success, tc)
@@ -2350,6 +2466,7 @@ ATF_TC_HEAD(nfs4_setattr_failure, tc)
 
 ATF_TC_BODY(nfs4_setattr_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2358,13 +2475,13 @@ ATF_TC_BODY(nfs4_setattr_failure, tc)
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SETATTR, &au_test_data);
-	const char *regex = "nfsrvd_setattr.*return,failure";
 
 	/* No PUTFH sub-operation. setattr will fail. */
 	m = htonl(m);
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_setattr_chmod(nfs, &op[0], nfsfh, &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SETATTR, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_setattr_failure, tc)
@@ -2381,14 +2498,15 @@ ATF_TC_HEAD(nfs4_setclientid_success, tc)
 
 ATF_TC_BODY(nfs4_setclientid_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SETCLIENTID, &au_test_data);
-	const char *regex = "nfsrvd_setclientid.*return,success";
 
 	i = nfs4_op_setclientid(nfs, &op[i], nfs->verifier, nfs->client_name);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SETCLIENTID, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_setclientid_success, tc)
@@ -2405,14 +2523,15 @@ ATF_TC_HEAD(nfs4_setclientidcfrm_success, tc)
 
 ATF_TC_BODY(nfs4_setclientidcfrm_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SETCLIENTIDCFRM, &au_test_data);
-	const char *regex = "nfsrvd_setclientidcfrm.*return,success";
 
 	i = nfs4_op_setclientid_confirm(nfs, &op[i], nfs->clientid, nfs->setclientid_confirm);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SETCLIENTIDCFRM, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_setclientidcfrm_success, tc)
@@ -2429,15 +2548,16 @@ ATF_TC_HEAD(nfs4_setclientidcfrm_failure, tc)
 
 ATF_TC_BODY(nfs4_setclientidcfrm_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i = 0;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_SETCLIENTIDCFRM, &au_test_data);
-	const char *regex = "nfsrvd_setclientidcfrm.*return,failure";
 
 	/* pass wrogn clientid as argument so that operation results in failure. */
 	i = nfs4_op_setclientid_confirm(nfs, &op[i], nfs->clientid + 0xff, nfs->setclientid_confirm);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_SETCLIENTIDCFRM, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_setclientidcfrm_failure, tc)
@@ -2454,6 +2574,7 @@ ATF_TC_HEAD(nfs4_verify_success, tc)
 
 ATF_TC_BODY(nfs4_verify_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2462,13 +2583,13 @@ ATF_TC_BODY(nfs4_verify_success, tc)
 	struct nfsfh *nfsfh = NULL;
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_VERIFY, &au_test_data);
-	const char *regex = "nfsrvd_verify.*return,success";
 
 	m = htonl(m);
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_verify_chmod(nfs, &op[i], &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_VERIFY, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_verify_success, tc)
@@ -2485,17 +2606,18 @@ ATF_TC_HEAD(nfs4_verify_failure, tc)
 
 ATF_TC_BODY(nfs4_verify_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	uint32_t m = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_VERIFY, &au_test_data);
-	const char *regex = "nfsrvd_verify.*return,failure";
 
 	/* NFSv4 VERIFY sub-operation will fail due to invalid use. (no PUTFH subop) */
 	m = htonl(m);
 	i = nfs4_op_verify_chmod(nfs, &op[0], &m);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_VERIFY, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_verify_failure, tc)
@@ -2512,6 +2634,7 @@ ATF_TC_HEAD(nfs4_write_success, tc)
 
 ATF_TC_BODY(nfs4_write_success, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2519,13 +2642,13 @@ ATF_TC_BODY(nfs4_write_success, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_WRITE, &au_test_data);
-	const char *regex = "nfsrvd_write.*return,success";
 	char wbuf[] = "buffer";
 
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDWR, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_write(nfs, &op[i], nfsfh, 0, strlen(wbuf), wbuf);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_WRITE, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_write_success, tc)
@@ -2542,6 +2665,7 @@ ATF_TC_HEAD(nfs4_write_failure, tc)
 
 ATF_TC_BODY(nfs4_write_failure, tc)
 {
+	tc_workdir();
 	ATF_REQUIRE(open(path, O_CREAT, 0777) != -1);
 
 	struct au_rpc_data au_test_data;
@@ -2549,14 +2673,14 @@ ATF_TC_BODY(nfs4_write_failure, tc)
 	nfs_argop4 op[2];
 	struct nfsfh *nfsfh = NULL;
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_WRITE, &au_test_data);
-	const char *regex = "nfsrvd_write.*return,failure";
 	char wbuf[] = "buffer";
 
 	/* The file is opened as Read only. Write will return error. */
 	ATF_REQUIRE_EQ(0, nfs_open(nfs, path, O_RDONLY, &nfsfh));
 	i = nfs4_op_putfh(nfs, &op[0], nfsfh);
 	i += nfs4_op_write(nfs, &op[i], nfsfh, 0, strlen(wbuf), wbuf);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_WRITE, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_write_failure, tc)
@@ -2573,14 +2697,15 @@ ATF_TC_HEAD(nfs4_releaselckown_success, tc)
 
 ATF_TC_BODY(nfs4_releaselckown_success, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RELEASELCKOWN, &au_test_data);
-	const char *regex = "nfsrvd_releaselckown.*return,success";
 
 	i = nfs4_op_release_lock_owner(nfs, &op[0], nfs->clientid);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, true);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RELEASELCKOWN, nfs, au_test_data,
+	    true, AU_MATCH_SUCCESS, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_releaselckown_success, tc)
@@ -2597,15 +2722,16 @@ ATF_TC_HEAD(nfs4_releaselckown_failure, tc)
 
 ATF_TC_BODY(nfs4_releaselckown_failure, tc)
 {
+	tc_workdir();
 	struct au_rpc_data au_test_data;
 	int i;
 	nfs_argop4 op[1];
 	struct nfs_context *nfs = tc_body_init(AUE_NFSV4OP_RELEASELCKOWN, &au_test_data);
-	const char *regex = "nfsrvd_releaselckown.*return,failure";
 
 	/* It fails due to invalid clientid. */
 	i = nfs4_op_release_lock_owner(nfs, &op[0], nfs->clientid + 0xffff);
-	NFS4_COMMON_PERFORM(i, op, regex, nfs, au_test_data, false);
+	NFS4_COMMON_PERFORM(i, op, AUE_NFSV4OP_RELEASELCKOWN, nfs, au_test_data,
+	    false, AU_MATCH_FAILURE, NULL);
 }
 
 ATF_TC_CLEANUP(nfs4_releaselckown_failure, tc)
@@ -2616,6 +2742,7 @@ ATF_TC_CLEANUP(nfs4_releaselckown_failure, tc)
 ATF_TP_ADD_TCS(tp)
 {
 	ATF_TP_ADD_TC(tp, nfs4_compound_rpc);
+	ATF_TP_ADD_TC(tp, nfs4_compound_subops);
 	ATF_TP_ADD_TC(tp, nfs4_access_success);
 	ATF_TP_ADD_TC(tp, nfs4_access_failure);
 	ATF_TP_ADD_TC(tp, nfs4_close_success);
@@ -25,73 +25,213 @@
  *
  */
 
+#include <sys/param.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+#include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifndef __linux__
+#include <sys/sysctl.h>
+#endif
+#include <sys/wait.h>
 
 #include <bsm/libbsm.h>
+#ifndef __linux__
 #include <security/audit/audit_ioctl.h>
+#endif
 
 #include <atf-c.h>
+#include <dirent.h>
+#include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "utils.h"
+#include "compat.h"
 
 static char SERVER[] = "127.1";
 
+extern char **environ;
+
+/* Time limit for the expected records to show up in auditpipe(4) */
+#define	AUDIT_TIMEOUT_MS	10000
+/* Default time the auditpipe may stay empty once the RPC is done */
+#define	AUDIT_QUIET_MS		3000
+/* Longest wait in ppoll(2) before the auditpipe counters are checked */
+#define	AUDIT_SLICE_MS		100
+/* Default time limit for the reply to an RPC, see rpc_timeout_ms() */
+#define	RPC_TIMEOUT_MS		10000
+/* First and longest wait before the NFS server is probed again */
+#define	PROBE_BACKOFF_MS	1
+#define	PROBE_BACKOFF_MAX_MS	256
+
+/* Statistics of a test, left in its work directory */
+static const char STATSFILE[] = "nfsaudit.stats";
+
 /*
- * Checks the presence of "auditregex" in auditpipe(4) after the
- * corresponding system call has been triggered.
+ * Files of nfs-audit-standin in the directory NFSAUDIT_STANDIN names: the
+ * FIFO its records are written to, the port it serves MOUNT and NFSv3 on,
+ * the count of the records it dropped and the stall of its replies.
  */
-static bool
-get_records(const char *auditregex, FILE *pipestream)
+static const char STANDIN_FIFO[] = "audit";
+static const char STANDIN_PORT[] = "port";
+static const char STANDIN_DROPS[] = "drops";
+static const char STANDIN_STALL[] = "stall";
+
+/*
+ * Counters of an auditpipe(4) instance, see AUDITPIPE_GET_* in
+ * audit_ioctl.h.
+ */
+struct au_pipe_stats {
+	u_int		qlen;
+	uint64_t	inserts;
+	uint64_t	reads;
+	uint64_t	drops;
+	uint64_t	truncates;
+};
+
+/*
+ * An instance of /dev/auditpipe opened by setup(), or the FIFO of
+ * nfs-audit-standin, along with the records read from it but not yet
+ * checked.
+ */
+struct au_pipe {
+	struct au_framer	framer;
+	struct au_arena		arena;
+	struct au_pipe_stats	before;	/* counters once setup() is done */
+	bool			reported;
+	bool			standin; /* the FIFO of nfs-audit-standin */
+};
+
+/* The work directory of the test case once tc_workdir() has left it */
+static char tc_dir[PATH_MAX];
+
+/*
+ * Path of the file "name" of the test case in its work directory, where
+ * its cleanup routine and kyua(1) look for it.
+ */
+static const char *
+tc_file(char *path, size_t len, const char *name)
 {
-	uint8_t *buff;
-	tokenstr_t token;
-	ssize_t size = 1024;
-	char membuff[size];
-	char del[] = ",";
-	int reclen, bytes = 0;
-	FILE *memstream;
+	if (tc_dir[0] == '\0')
+		return (name);
+	snprintf(path, len, "%s/%s", tc_dir, name);
+	return (path);
+}
 
-	/*
-	 * Open a stream on 'membuff' (address to memory buffer) for storing
-	 * the audit records in the default mode.'reclen' is the length of the
-	 * available records from auditpipe which is passed to the functions
-	 * au_fetch_tok(3) and au_print_flags_tok(3) for further use.
-	 */
-	ATF_REQUIRE((memstream = fmemopen(membuff, size, "w")) != NULL);
-	ATF_REQUIRE((reclen = au_read_rec(pipestream, &buff)) != -1);
+/*
+ * Append "prefix.key=value" to the statistics file of the test. It is
+ * meant to be machine readable, one value per line.
+ */
+void
+record_stat(const char *prefix, const char *key, uintmax_t value)
+{
+	char path[PATH_MAX];
+	FILE *statsfile;
 
-	/*
-	 * Iterate through each BSM token, extracting the bits that are
-	 * required to start processing the token sequences.
-	 */
-	while (bytes < reclen) {
-		if (au_fetch_tok(&token, buff + bytes, reclen - bytes) == -1) {
-			perror("au_read_rec");
-			atf_tc_fail("Incomplete Audit Record");
-		}
+	if ((statsfile = fopen(tc_file(path, sizeof(path), STATSFILE),
+	    "a")) == NULL)
+		return;
+	fprintf(statsfile, "%s.%s=%ju\n", prefix, key, value);
+	fclose(statsfile);
+}
+
+/*
+ * The directory of the nfs-audit-standin to test against instead of the
+ * kernel NFS server and audit, NULL if none.
+ */
+static const char *
+standin_dir(void)
+{
+	return (getenv("NFSAUDIT_STANDIN"));
+}
+
+/*
+ * The FIFO of nfs-audit-standin has no counters but the bytes it holds,
+ * which are enough to tell whether more records are pending, and the drops
+ * the stand-in keeps in a file of its directory.
+ */
+static void
+get_pipe_stats(const struct au_pipe *aupipe, struct au_pipe_stats *stats)
+{
+	int filedesc = aupipe->framer.fd;
+	char path[PATH_MAX];
+	FILE *dropsfile;
+	uintmax_t drops;
+	int qlen;
 
-		/* Print the tokens as they are obtained, in the default form */
-		au_print_flags_tok(memstream, &token, del, AU_OFLAG_NONE);
-		bytes += token.len;
+	if (aupipe->standin) {
+		memset(stats, 0, sizeof(*stats));
+		ATF_REQUIRE_EQ(0, ioctl(filedesc, FIONREAD, &qlen));
+		stats->qlen = (u_int)qlen;
+		snprintf(path, sizeof(path), "%s/%s", standin_dir(),
+		    STANDIN_DROPS);
+		ATF_REQUIRE_MSG((dropsfile = fopen(path, "r")) != NULL,
+		    "%s: %s", path, strerror(errno));
+		ATF_REQUIRE_EQ(1, fscanf(dropsfile, "%ju", &drops));
+		fclose(dropsfile);
+		stats->drops = drops;
+		return;
 	}
+#ifndef __linux__
+	ATF_REQUIRE_EQ(0, ioctl(filedesc, AUDITPIPE_GET_QLEN, &stats->qlen));
+	ATF_REQUIRE_EQ(0, ioctl(filedesc, AUDITPIPE_GET_INSERTS,
+	    &stats->inserts));
+	ATF_REQUIRE_EQ(0, ioctl(filedesc, AUDITPIPE_GET_READS, &stats->reads));
+	ATF_REQUIRE_EQ(0, ioctl(filedesc, AUDITPIPE_GET_DROPS, &stats->drops));
+	ATF_REQUIRE_EQ(0, ioctl(filedesc, AUDITPIPE_GET_TRUNCATES,
+	    &stats->truncates));
+#endif
+}
+
+static void
+write_pipe_stats(const char *prefix, const struct au_pipe_stats *stats)
+{
+	record_stat(prefix, "qlen", stats->qlen);
+	record_stat(prefix, "inserts", stats->inserts);
+	record_stat(prefix, "reads", stats->reads);
+	record_stat(prefix, "drops", stats->drops);
+	record_stat(prefix, "truncates", stats->truncates);
+}
+
+/*
+ * Record the auditpipe counters from the end of setup() and those of now,
+ * once per instance, so that drops and the depth of the queue can be told
+ * whether the test passes or not.
+ */
+static void
+report_pipe_stats(struct au_pipe *aupipe)
+{
+	struct au_pipe_stats after;
 
-	free(buff);
-	ATF_REQUIRE_EQ(0, fclose(memstream));
-	return (atf_utils_grep_string("%s", membuff, auditregex));
+	if (aupipe->reported)
+		return;
+	aupipe->reported = true;
+	get_pipe_stats(aupipe, &after);
+	write_pipe_stats("auditpipe.before", &aupipe->before);
+	write_pipe_stats("auditpipe.after", &after);
 }
 
+#ifndef __linux__
 /*
  * Override the system-wide audit mask settings in /etc/security/audit_control
  * and set the auditpipe's maximum allowed queue length limit
  */
 static void
-set_preselect_mode(int filedesc, au_mask_t *fmask)
+set_preselect_mode(int filedesc)
 {
 	int qlimit_max;
 	int fmode = AUDITPIPE_PRESELECT_MODE_LOCAL;
@@ -100,6 +240,21 @@ set_preselect_mode(int filedesc, au_mask_t *fmask)
 	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_MODE, &fmode) < 0)
 		atf_tc_fail("Preselection mode: %s", strerror(errno));
 
+	/* Query the maximum possible queue length limit for auditpipe */
+	if (ioctl(filedesc, AUDITPIPE_GET_QLIMIT_MAX, &qlimit_max) < 0)
+		atf_tc_fail("Query max-limit: %s", strerror(errno));
+
+	/* Set the queue length limit as obtained from previous step */
+	if (ioctl(filedesc, AUDITPIPE_SET_QLIMIT, &qlimit_max) < 0)
+		atf_tc_fail("Set max-qlimit: %s", strerror(errno));
+}
+
+/*
+ * Set the local preselection flags of the auditpipe to fmask.
+ */
+static void
+set_preselect_flags(int filedesc, au_mask_t *fmask)
+{
 	/* Set local preselection flag corresponding to the audit_event */
 	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_FLAGS, fmask) < 0)
 		atf_tc_fail("Preselection flag: %s", strerror(errno));
@@ -107,20 +262,38 @@ set_preselect_mode(int filedesc, au_mask_t *fmask)
 	/* Set local preselection flag for non-attributable audit_events */
 	if (ioctl(filedesc, AUDITPIPE_SET_PRESELECT_NAFLAGS, fmask) < 0)
 		atf_tc_fail("Preselection naflag: %s", strerror(errno));
+}
+#endif
 
-	/* Query the maximum possible queue length limit for auditpipe */
-	if (ioctl(filedesc, AUDITPIPE_GET_QLIMIT_MAX, &qlimit_max) < 0)
-		atf_tc_fail("Query max-limit: %s", strerror(errno));
-
-	/* Set the queue length limit as obtained from previous step */
-	if (ioctl(filedesc, AUDITPIPE_SET_QLIMIT, &qlimit_max) < 0)
-		atf_tc_fail("Set max-qlimit: %s", strerror(errno));
+/*
+ * Remove any outstanding record from the auditpipe, so that only the
+ * records which come next are checked, and take its counters from then.
+ */
+static void
+flush_auditpipe(struct au_pipe *aupipe)
+{
+	char buf[BUFSIZ];
+	ssize_t len;
 
-	/* This removes any outstanding record on the auditpipe */
-	if (ioctl(filedesc, AUDITPIPE_FLUSH) < 0)
-		atf_tc_fail("Auditpipe flush: %s", strerror(errno));
+	/* The FIFO has no flush, whatever it holds is read and discarded */
+	if (aupipe->standin) {
+		while ((len = read(aupipe->framer.fd, buf, sizeof(buf))) > 0)
+			;
+		ATF_REQUIRE_MSG(len == -1 && errno == EAGAIN,
+		    "Auditpipe flush: %s", len == 0 ?
+		    "nfs-audit-standin is gone" : strerror(errno));
+	} else {
+#ifndef __linux__
+		if (ioctl(aupipe->framer.fd, AUDITPIPE_FLUSH) < 0)
+			atf_tc_fail("Auditpipe flush: %s", strerror(errno));
+#endif
+	}
+	au_framer_reset(&aupipe->framer);
+	get_pipe_stats(aupipe, &aupipe->before);
+	aupipe->reported = false;
 }
 
+#ifndef __linux__
 /*
  * Get the corresponding audit_mask for class-name "name" then set the
  * success and failure bits for fmask to be used as the ioctl argument
@@ -137,42 +310,155 @@ get_audit_mask(const char *name)
 	fmask.am_failure = class->ac_class;
 	return (fmask);
 }
+#endif
+
+/*
+ * Fail the test with the list of the expected records not found yet and
+ * "why" they were not.
+ */
+static void
+fail_missing(const struct au_match *matches, const bool found[], int nmatch,
+    struct au_pipe *aupipe, const char *why)
+{
+	char descr[256], missing[1024];
+	size_t len;
+	int i;
+
+	missing[0] = '\0';
+	for (i = 0, len = 0; i < nmatch; i++) {
+		if (found[i] || len >= sizeof(missing))
+			continue;
+		au_match_describe(&matches[i], descr, sizeof(descr));
+		len += snprintf(missing + len, sizeof(missing) - len, "%s%s",
+		    len != 0 ? "; " : "", descr);
+	}
+	report_pipe_stats(aupipe);
+	atf_tc_fail("%s not found in auditpipe %s", missing, why);
+}
+
+static long
+elapsed_ms(const struct timespec *since)
+{
+	struct timespec now;
+
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &now));
+	return ((now.tv_sec - since->tv_sec) * 1000 +
+	    (now.tv_nsec - since->tv_nsec) / 1000000);
+}
+
+/*
+ * Time the auditpipe may stay empty, once the RPC is done, before the
+ * expected records are given up on. NFSAUDIT_QUIET_MS overrides it.
+ */
+static long
+quiet_period(void)
+{
+	const char *env;
+	long ms;
+
+	if ((env = getenv("NFSAUDIT_QUIET_MS")) == NULL ||
+	    (ms = strtol(env, NULL, 10)) <= 0)
+		return (AUDIT_QUIET_MS);
+	return (ms);
+}
 
 /*
  * Loop until the auditpipe returns something, check if it is what
- * we want, else repeat the procedure until ppoll(2) times out.
+ * we want, else repeat the procedure until ppoll(2) times out. All of
+ * the "nmatch" records in "matches" are looked for in the same pass, each
+ * record against the raw BSM tokens first and only rendered into the
+ * arena of this auditpipe if a candidate has a regex.
+ *
+ * ppoll(2) wakes up at least every AUDIT_SLICE_MS, so that the wait ends
+ * as soon as the auditpipe is drained and has stayed empty for the "quiet"
+ * period in ms (none if 0). Waiting longer would not bring the missing
+ * records. A drop since setup() fails the test as soon as it is seen: the
+ * records expected may be among those lost, and a test which passes only
+ * as they were not would hide the loss.
  */
 static void
-check_auditpipe(struct pollfd fd[], const char *auditregex, FILE *pipestream)
+check_auditpipe(struct pollfd fd[], const struct au_match *matches,
+    int nmatch, bool ordered, long quiet, struct au_pipe *aupipe)
 {
-	struct timespec currtime, endtime, timeout;
+	struct au_pipe_stats stats;
+	struct timespec starttime, lastrec, timeout;
+	char why[128];
+	bool found[nmatch];
+	u_char *buff;
+	size_t reclen;
+	long waited, slice;
+	int error, i, left = nmatch;
+
+	memset(found, 0, sizeof(found));
 
-	/* Set the expire time for poll(2) while waiting for syscall audit */
-	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &endtime));
-	endtime.tv_sec += 10;
-	timeout.tv_nsec = endtime.tv_nsec;
+	/* Set the start time for poll(2) while waiting for syscall audit */
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &starttime));
+	lastrec = starttime;
 
 	for (;;) {
+		/*
+		 * Records already framed are invisible to ppoll(2), check all
+		 * of them before waiting on the auditpipe again.
+		 */
+		while ((error = au_framer_next(&aupipe->framer, &buff,
+		    &reclen)) == 1) {
+			i = au_match_next(matches, found, nmatch, ordered,
+			    &aupipe->arena, buff, reclen);
+			if (i == -2) {
+				perror("au_fetch_tok");
+				atf_tc_fail("Incomplete Audit Record");
+			}
+			if (i == -1)
+				continue;
+			found[i] = true;
+			if (--left == 0)
+				return;
+		}
+		if (error == -1)
+			atf_tc_fail("Incomplete Audit Record");
+
+		get_pipe_stats(aupipe, &stats);
+		if (stats.drops > aupipe->before.drops) {
+			snprintf(why, sizeof(why), "as auditpipe dropped %ju "
+			    "records", (uintmax_t)(stats.drops -
+			    aupipe->before.drops));
+			fail_missing(matches, found, nmatch, aupipe, why);
+		}
+
 		/* Update the time left for auditpipe to return any event */
-		ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &currtime));
-		timeout.tv_sec = endtime.tv_sec - currtime.tv_sec;
+		if ((waited = elapsed_ms(&starttime)) >= AUDIT_TIMEOUT_MS)
+			fail_missing(matches, found, nmatch, aupipe,
+			    "within the time limit");
+		slice = MIN(AUDIT_SLICE_MS, AUDIT_TIMEOUT_MS - waited);
+		timeout.tv_sec = slice / 1000;
+		timeout.tv_nsec = slice % 1000 * 1000000;
 
 		switch (ppoll(fd, 1, &timeout, NULL)) {
 		/* ppoll(2) returns, check if it's what we want */
 		case 1:
 			if (fd[0].revents & POLLIN) {
-				if (get_records(auditregex, pipestream))
-					return;
+				ATF_REQUIRE_MSG(
+				    au_framer_fill(&aupipe->framer) > 0,
+				    "Auditpipe read: %s", strerror(errno));
+				ATF_REQUIRE_EQ(0,
+				    clock_gettime(CLOCK_MONOTONIC, &lastrec));
 			} else {
 				atf_tc_fail("Auditpipe returned an "
 				"unknown event %#x", fd[0].revents);
 			}
 			break;
 
-		/* poll(2) timed out */
+		/* poll(2) timed out, give up early if nothing is to come */
 		case 0:
-			atf_tc_fail("%s not found in auditpipe within the "
-					"time limit", auditregex);
+			get_pipe_stats(aupipe, &stats);
+			if (stats.qlen != 0)
+				break;
+			if (quiet != 0 && elapsed_ms(&lastrec) >= quiet) {
+				snprintf(why, sizeof(why), "which stayed empty "
+				    "for %ld ms", quiet);
+				fail_missing(matches, found, nmatch, aupipe,
+				    why);
+			}
 			break;
 
 		/* poll(2) standard error */
@@ -187,165 +473,2124 @@ check_auditpipe(struct pollfd fd[], const char *auditregex, FILE *pipestream)
 }
 
 /*
- * Wrapper functions around static "check_auditpipe"
+ * Wait for a record matching the regex "auditrgx", compiled only once for
+ * all the records read until then.
+ */
+static void
+check_auditpipe_regex(struct pollfd fd[], const char *auditrgx, long quiet,
+    struct au_pipe *aupipe)
+{
+	struct au_match match;
+
+	au_match_init(&match, AU_MATCH_ANYEVENT, AU_MATCH_ANY);
+	ATF_REQUIRE_EQ_MSG(0, au_match_regex(&match, auditrgx),
+	    "Invalid regex %s", auditrgx);
+	check_auditpipe(fd, &match, 1, false, quiet, aupipe);
+	au_match_free(&match);
+}
+
+/*
+ * Teardown: /dev/auditpipe's instance opened for this test case, once its
+ * counters are recorded.
  */
 static void
-check_audit_startup(struct pollfd fd[], const char *auditrgx, FILE *pipestream){
-	check_auditpipe(fd, auditrgx, pipestream);
+release_auditpipe(struct au_pipe *aupipe)
+{
+	report_pipe_stats(aupipe);
+	ATF_REQUIRE_EQ(0, close(aupipe->framer.fd));
+	au_framer_free(&aupipe->framer);
+	au_arena_free(&aupipe->arena);
+	free(aupipe);
 }
 
+/*
+ * Wrapper functions around static "check_auditpipe"
+ */
 void
-check_audit(struct pollfd fd[], const char *auditrgx, FILE *pipestream) {
-	check_auditpipe(fd, auditrgx, pipestream);
+check_audit(struct pollfd fd[], const char *auditrgx, struct au_pipe *aupipe)
+{
+	check_auditpipe_regex(fd, auditrgx, quiet_period(), aupipe);
+	release_auditpipe(aupipe);
+}
 
-	/* Teardown: /dev/auditpipe's instance opened for this test-suite */
-	ATF_REQUIRE_EQ(0, fclose(pipestream));
+void
+check_audit_match(struct pollfd fd[], const struct au_match *match,
+    struct au_pipe *aupipe)
+{
+	check_auditpipe(fd, match, 1, false, quiet_period(), aupipe);
+	release_auditpipe(aupipe);
 }
 
-FILE
-*setup(struct pollfd fd[], const char *name)
+/*
+ * Wait for all the "nmatch" records in "matches" in a single pass over the
+ * auditpipe, e.g. those of a COMPOUND and its sub-ops. If "ordered", they
+ * must appear in sequence. The failure lists the records still missing.
+ */
+void
+check_audit_set(struct pollfd fd[], const struct au_match *matches,
+    int nmatch, bool ordered, struct au_pipe *aupipe)
 {
-	au_mask_t fmask, nomask;
-	fmask = get_audit_mask(name);
-	nomask = get_audit_mask("no");
-	FILE *pipestream;
+	check_auditpipe(fd, matches, nmatch, ordered, quiet_period(), aupipe);
+	release_auditpipe(aupipe);
+}
 
-	ATF_REQUIRE((fd[0].fd = open("/dev/auditpipe", O_RDONLY)) != -1);
-	ATF_REQUIRE((pipestream = fdopen(fd[0].fd, "r")) != NULL);
-	fd[0].events = POLLIN;
+#ifndef __linux__
+/*
+ * Process id written in pidfile, -1 if there is none.
+ */
+static pid_t
+read_pidfile(const char *pidfile)
+{
+	FILE *fp;
+	long pid;
 
-	/*
-	 * Disable stream buffering for read operations from /dev/auditpipe.
-	 * Otherwise it is possible that fread(3), called via au_read_rec(3),
-	 * can store buffered data in user-space unbeknown to ppoll(2), which
-	 * as a result, reports that /dev/auditpipe is empty.
-	 */
-	ATF_REQUIRE_EQ(0, setvbuf(pipestream, NULL, _IONBF, 0));
+	if ((fp = fopen(pidfile, "r")) == NULL)
+		return (-1);
+	if (fscanf(fp, "%ld", &pid) != 1 || pid <= 0)
+		pid = -1;
+	fclose(fp);
+	return ((pid_t)pid);
+}
 
-	/* Set local preselection audit_class as "no" for audit startup */
-	set_preselect_mode(fd[0].fd, &nomask);
-	ATF_REQUIRE_EQ(0, system("service auditd onestatus || \
-	{ service auditd onestart && touch started_auditd ; }"));
+/*
+ * An rc.d(8) service the tests depend on. Whether it runs is found out from
+ * the pidfile of its daemon and kill(2), and the pid is remembered, rather
+ * than asking "service name onestatus". service(8) is only run to change
+ * the state of the service.
+ */
+struct service {
+	const char	*name;
+	const char	*pidfile;
+	pid_t		pid;	/* last pid seen running, 0 if none */
+};
 
-	/* If 'started_auditd' exists, that means we started auditd(8) */
-	if (atf_utils_file_exists("started_auditd"))
-		check_audit_startup(fd, "audit startup", pipestream);
+static struct service svc_auditd = { "auditd", "/var/run/auditd.pid", 0 };
+static struct service svc_mountd = { "mountd", "/var/run/mountd.pid", 0 };
+static struct service svc_nfsd = { "nfsd", "/var/run/nfsd.pid", 0 };
 
-	/* Set local preselection parameters specific to "name" audit_class */
-	set_preselect_mode(fd[0].fd, &fmask);
-	return (pipestream);
+static bool
+pid_alive(pid_t pid)
+{
+	return (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM));
 }
 
-void
-cleanup(void)
+static bool
+service_running(struct service *svc)
 {
-	if (atf_utils_file_exists("started_auditd"))
-		system("service auditd onestop > /dev/null 2>&1");
-	if (atf_utils_file_exists("mountd_running"))
-		system("service mountd restart > /dev/null 2>&1");
-	else
-		system("service mountd onestop > /dev/null 2>&1");
-	if (atf_utils_file_exists("started_nfsd"))
-		system("service nfsd onestop > /dev/null 2>&1");
+	if (pid_alive(svc->pid))
+		return (true);
+	svc->pid = read_pidfile(svc->pidfile);
+	if (pid_alive(svc->pid))
+		return (true);
+	svc->pid = 0;
+	return (false);
 }
 
-struct nfs_context
-*tc_body_init(int au_rpc_event, struct au_rpc_data* au_test_data)
+/*
+ * Run argv without a shell. Returns 0 if it exits with status 0, -1 and a
+ * warning otherwise.
+ */
+static int
+run_command(const char *const argv[])
 {
-	struct nfs_context *nfs;
-	struct nfs_url url;
-	char cwd[PATH_MAX + 1];
-	FILE *exportsfile;
-	int error;
-
-	nfs = nfs_init_context();
-	ATF_REQUIRE(nfs != NULL);
-	au_test_data->au_rpc_event = au_rpc_event;
-	au_test_data->au_rpc_status = -1;
-	au_test_data->au_rpc_result = -1;
-	au_test_data->is_finished = 0;
+	pid_t pid;
+	int error, status;
 
-	/* XXX TODO: Make the nfsv4_server_enable change temporary. */
-	if (au_rpc_event >= AUE_NFSV4RPC_COMPOUND) {
-		ATF_REQUIRE_EQ(0, nfs_set_version(nfs, NFS_V4));
-		system("sysrc nfsv4_server_enable=YES");
+	error = posix_spawnp(&pid, argv[0], NULL, NULL,
+	    __DECONST(char **, argv), environ);
+	if (error != 0) {
+		warnc(error, "%s", argv[0]);
+		return (-1);
+	}
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR) {
+			warn("waitpid");
+			return (-1);
+		}
 	}
-	ATF_REQUIRE_EQ(0, system(" ! { service mountd onestatus ; } || \
-	    { service mountd onestop && touch mountd_running ; }"));
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		warnx("%s exited with status %#x", argv[0], status);
+		return (-1);
+	}
+	return (0);
+}
 
-	ATF_REQUIRE(getcwd(cwd, PATH_MAX) != NULL);
-	ATF_REQUIRE((exportsfile = fopen("NFSAuditExports", "w")) != NULL);
+/*
+ * Run "service name verb", e.g. "onestart", and forget the pid.
+ */
+static int
+service_control(struct service *svc, const char *verb)
+{
+	const char *argv[] = { "service", svc->name, verb, NULL };
 
-	if (au_rpc_event >= AUE_NFSV4RPC_COMPOUND)
-		fprintf(exportsfile, "V4: / %s\n", SERVER);
-	fprintf(exportsfile, "%s -mapall=root %s\n", cwd, SERVER);
-	fclose(exportsfile);
-	ATF_REQUIRE_EQ(0, system("mountd NFSAuditExports"));
+	svc->pid = 0;
+	return (run_command(argv));
+}
+#endif
+
+/*
+ * Open an instance of the auditpipe, or the FIFO of nfs-audit-standin.
+ */
+static struct au_pipe *
+open_auditpipe(void)
+{
+	struct au_pipe *aupipe;
+	const char *capture, *dir;
+	char path[PATH_MAX];
+	int filedesc;
+
+	ATF_REQUIRE((aupipe = calloc(1, sizeof(*aupipe))) != NULL);
+	if ((dir = standin_dir()) != NULL) {
+		snprintf(path, sizeof(path), "%s/%s", dir, STANDIN_FIFO);
+		ATF_REQUIRE_MSG((filedesc = open(path,
+		    O_RDONLY | O_NONBLOCK)) != -1, "%s: %s", path,
+		    strerror(errno));
+		aupipe->standin = true;
+	} else {
+#ifdef __linux__
+		atf_tc_skip("Only nfs-audit-standin runs on Linux, see "
+		    "NFSAUDIT_STANDIN");
+#endif
+		ATF_REQUIRE((filedesc = open("/dev/auditpipe",
+		    O_RDONLY)) != -1);
+	}
 
-	ATF_REQUIRE_EQ(0, system("service nfsd onestatus || \
-	    { service nfsd onestart && touch started_nfsd ; }"));
 	/*
-	 * restart nfsd, just to make sure changed configurations are properly loaded
-	 * if nfsd was already running.
+	 * Records are read from /dev/auditpipe in large chunks and framed
+	 * in user-space. The framer keeps track of the complete records it
+	 * holds, which ppoll(2) cannot see, so that check_auditpipe() never
+	 * waits on an auditpipe that looks empty while records are pending.
 	 */
-//	if (!atf_utils_file_exists("started_nfsd"))
-//		ATF_REQUIRE_EQ(0, system("service nfsd restart"));
-
-	url.server = SERVER;
-	url.path = cwd;
+	ATF_REQUIRE_EQ(0, au_framer_init(&aupipe->framer, filedesc));
+	ATF_REQUIRE_EQ(0, au_arena_init(&aupipe->arena));
 
 	/*
-	 * XXX: NFSv4 nfs_mount is not working properly if nfsd isn't already
-	 * running.
+	 * Keep a raw copy of the records if asked to, which can be replayed
+	 * offline with "nfs-audit-trail replay".
 	 */
-	if (au_rpc_event >= AUE_NFSV4RPC_COMPOUND)
-		usleep(200000);
-	/* loop waiting for nfsd to be ready to accept connections */
-	for(;;) {
-		error = nfs_mount(nfs, url.server, url.path);
-		/*
-		 * for reasons of its own, libnfs returns EFAULT if the mount
-		 * fails.
-		 */
-		if (error != -EFAULT)
-			break;
-		usleep(10000);
+	if ((capture = getenv("NFSAUDIT_CAPTURE")) != NULL)
+		ATF_REQUIRE_MSG(
+		    au_framer_capture(&aupipe->framer, capture) == 0,
+		    "%s: %s", capture, strerror(errno));
+
+#ifndef __linux__
+	/* nfs-audit-standin writes the records of every NFSv3 call */
+	if (aupipe->standin)
+		return (aupipe);
+	set_preselect_mode(filedesc);
+#endif
+	return (aupipe);
+}
+
+#ifndef __linux__
+/*
+ * Have auditd(8) running and the auditpipe preselect the class "name".
+ */
+static void
+setup_audit(struct au_pipe *aupipe, const char *name)
+{
+	au_mask_t fmask;
+	char path[PATH_MAX];
+	long ready;
+
+	fmask = get_audit_mask(name);
+
+	/* auditd(8) is shared with the other test cases, like the NFS server */
+	tc_file(path, sizeof(path), "audit_acquired");
+	if (!atf_utils_file_exists(path)) {
+		ready = fixture_acquire_audit();
+		ATF_REQUIRE_MSG(ready >= 0, "Unable to enable auditing");
+		atf_utils_create_file(path, "%s", "");
+		record_stat("auditd", "ready_ms", (uintmax_t)ready);
 	}
-	ATF_REQUIRE_EQ_MSG(error, 0, "nfs_mount: %d, %s",-error, strerror(-error));
 
-	return nfs;
+	/* Set local preselection parameters specific to "name" audit_class */
+	set_preselect_flags(aupipe->framer.fd, &fmask);
 }
+#endif
 
-int
-nfs_poll_fd(struct nfs_context *nfs, struct au_rpc_data *au_test_data)
+struct au_pipe
+*setup(struct pollfd fd[], const char *name)
 {
-	struct pollfd pfd;
-	struct rpc_context *rpc = nfs_get_rpc_context(nfs);	
+	struct au_pipe *aupipe;
 
-	for (;;) {
-		pfd.fd = rpc_get_fd(rpc);
-		pfd.events = rpc_which_events(rpc);
-		ATF_REQUIRE_MSG(poll(&pfd, 1, -1) >= 0, "poll failed");
-		if (rpc_service(rpc, pfd.revents) < 0) {
-			atf_tc_fail("rpc_service failed");
-			break;
-		}
-		if (au_test_data->is_finished)
-			break;
+	aupipe = open_auditpipe();
+	fd[0].fd = aupipe->framer.fd;
+	fd[0].events = POLLIN;
+#ifndef __linux__
+	if (!aupipe->standin)
+		setup_audit(aupipe, name);
+#else
+	(void)name;
+#endif
+	flush_auditpipe(aupipe);
+	return (aupipe);
+}
+
+#ifndef __linux__
+/*
+ * The NFS server fixture: one mountd(8) exporting a directory of its own
+ * to each test case under EXPORTDIR, nfsd(8) and auditd(8), which setup()
+ * takes through fixture_acquire_audit(). It is brought up by the first
+ * test case and shared by the next ones, each of which only adds its
+ * directory to the exports. The fixture is
+ * reference counted in FIXTUREDIR and taken down by the last user to
+ * release it. Only if NFSAUDIT_FIXTURE_LINGER asks for it, a detached
+ * reaper instead waits for that many seconds and takes the fixture down
+ * then, so that consecutive test programs do not restart the daemons in
+ * between. A new user stops the reaper first.
+ */
+static const char FIXTUREDIR[] = "/var/run/nfs-audit";
+/* Where the directories of the users of the fixture are made */
+static const char EXPORTDIR[] = "/var/run/nfs-audit/export";
+/*
+ * exports(5) files of the system, which the mountd(8) of the fixture keeps
+ * serving along with its own.
+ */
+static const char *const sys_exports[] = { "/etc/exports",
+    "/etc/zfs/exports" };
+/* Time limit for mountd(8) to apply a new export set */
+#define	EXPORT_TIMEOUT_MS	5000
+/* Time limit for auditd(8) to enable auditing */
+#define	AUDITD_TIMEOUT_MS	10000
+
+/*
+ * Path of the state file "name" of the fixture.
+ */
+static void
+fixture_path(char *path, size_t len, const char *name)
+{
+	snprintf(path, len, "%s/%s", FIXTUREDIR, name);
+}
+
+/*
+ * Value of the state "name" of the fixture, 0 if it is not set.
+ */
+static long
+fixture_get(const char *name)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+	long value;
+
+	fixture_path(path, sizeof(path), name);
+	if ((fp = fopen(path, "r")) == NULL)
+		return (0);
+	if (fscanf(fp, "%ld", &value) != 1)
+		value = 0;
+	fclose(fp);
+	return (value);
+}
+
+static int
+fixture_set(const char *name, long value)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	fixture_path(path, sizeof(path), name);
+	if ((fp = fopen(path, "w")) == NULL) {
+		warn("%s", path);
+		return (-1);
 	}
+	fprintf(fp, "%ld\n", value);
+	return (fclose(fp) == 0 ? 0 : -1);
+}
 
-	nfs_umount(nfs);
-	rpc_destroy_context(nfs->rpc);
-	nfs->rpc = NULL;
-	free(nfs);
+/*
+ * Take the lock serializing the users of the fixture, which is released
+ * when the returned descriptor is closed.
+ */
+static int
+fixture_lock(void)
+{
+	char path[PATH_MAX];
+	int lockfd;
 
-	return au_test_data->au_rpc_status;
+	if (mkdir(FIXTUREDIR, 0755) == -1 && errno != EEXIST) {
+		warn("%s", FIXTUREDIR);
+		return (-1);
+	}
+	fixture_path(path, sizeof(path), "lock");
+	if ((lockfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) == -1) {
+		warn("%s", path);
+		return (-1);
+	}
+	if (flock(lockfd, LOCK_EX) == -1) {
+		warn("flock: %s", path);
+		close(lockfd);
+		return (-1);
+	}
+	return (lockfd);
 }
 
-void
-nfs_res_close_cb(__unused struct nfs_context *nfs, int status, void *data, void *private_data)
+/*
+ * Wait until mountd(8) on SERVER lists dir in its exports, which is how a
+ * reload is known to have been applied. Returns -1 and a warning if it
+ * does not within timeout_ms.
+ */
+static int
+wait_export(const char *dir, long timeout_ms)
 {
-	struct au_rpc_data* au_test_data = (struct au_rpc_data *)private_data;
+	struct exportnode *list, *ex;
+	struct timespec start;
+	long backoff;
+	bool found;
+
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &start));
+	backoff = PROBE_BACKOFF_MS;
+	for (;;) {
+		found = false;
+		list = mount_getexports(SERVER);
+		for (ex = list; ex != NULL && !found; ex = ex->ex_next)
+			found = strcmp(ex->ex_dir, dir) == 0;
+		mount_free_export_list(list);
+		if (found)
+			return (0);
+		if (elapsed_ms(&start) + backoff >= timeout_ms) {
+			warnx("mountd does not export %s after %ld ms", dir,
+			    elapsed_ms(&start));
+			return (-1);
+		}
+		usleep((useconds_t)backoff * 1000);
+		backoff = MIN(backoff * 2, PROBE_BACKOFF_MAX_MS);
+	}
+}
+
+/*
+ * Export the directory of every user of the fixture under EXPORTDIR to
+ * SERVER alone. The first call starts a mountd(8) on the exports(5) files
+ * of the system and that of the fixture, after stopping a mountd(8)
+ * running with those of the system alone, which fixture_teardown()
+ * restarts. Later calls reload it with SIGHUP. Either way, returns once
+ * mountd(8) lists the current directory, and the directories exported are
+ * then kept in the "export" state file.
+ */
+static int
+fixture_export(void)
+{
+	char cwd[PATH_MAX], exportspath[PATH_MAX], list[PATH_MAX];
+	char line[PATH_MAX], path[PATH_MAX];
+	const char *mountd[nitems(sys_exports) + 3];
+	struct dirent *dp;
+	FILE *exportsfile, *listfile, *fp;
+	DIR *dirp;
+	bool v4root;
+	size_t i, n;
+	int ndirs;
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL) {
+		warn("getcwd");
+		return (-1);
+	}
+
+	/* The pseudo root of NFSv4 can be set once, by the system if at all */
+	n = 0;
+	mountd[n++] = "mountd";
+	v4root = false;
+	for (i = 0; i < nitems(sys_exports); i++) {
+		if ((fp = fopen(sys_exports[i], "r")) == NULL)
+			continue;
+		mountd[n++] = sys_exports[i];
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if (strncmp(line + strspn(line, " \t"), "V4:", 3) == 0)
+				v4root = true;
+		}
+		fclose(fp);
+	}
+	fixture_path(exportspath, sizeof(exportspath), "exports");
+	mountd[n++] = exportspath;
+	mountd[n] = NULL;
+
+	fixture_path(list, sizeof(list), "export.new");
+	if ((dirp = opendir(EXPORTDIR)) == NULL) {
+		warn("%s", EXPORTDIR);
+		return (-1);
+	}
+	if ((exportsfile = fopen(exportspath, "w")) == NULL ||
+	    (listfile = fopen(list, "w")) == NULL) {
+		warn("%s", exportsfile == NULL ? exportspath : list);
+		if (exportsfile != NULL)
+			fclose(exportsfile);
+		closedir(dirp);
+		return (-1);
+	}
+	if (!v4root)
+		fprintf(exportsfile, "V4: / %s\n", SERVER);
+	/* Directories of a file system exported alike share a line */
+	ndirs = 0;
+	while ((dp = readdir(dirp)) != NULL) {
+		if (dp->d_type != DT_DIR || dp->d_name[0] == '.')
+			continue;
+		fprintf(exportsfile, "%s/%s ", EXPORTDIR, dp->d_name);
+		fprintf(listfile, "%s/%s\n", EXPORTDIR, dp->d_name);
+		ndirs++;
+	}
+	closedir(dirp);
+	if (ndirs != 0)
+		fprintf(exportsfile, "-mapall=root %s\n", SERVER);
+	if (fclose(listfile) != 0 || fclose(exportsfile) != 0) {
+		warn("%s", exportspath);
+		return (-1);
+	}
+
+	/*
+	 * Once the fixture has its mountd(8), a new export set is applied
+	 * by having it reload the exports(5) files rather than restarting it.
+	 */
+	if (!fixture_get("mountd")) {
+		if (service_running(&svc_mountd)) {
+			if (service_control(&svc_mountd, "onestop") != 0)
+				return (-1);
+			fixture_set("mountd_running", 1);
+		}
+		if (run_command(mountd) != 0)
+			return (-1);
+	} else if (!service_running(&svc_mountd) ||
+	    kill(svc_mountd.pid, SIGHUP) == -1) {
+		warn("Unable to reload mountd");
+		return (-1);
+	}
+	if (wait_export(cwd, EXPORT_TIMEOUT_MS) != 0)
+		return (-1);
+	fixture_set("mountd", 1);
+	fixture_path(path, sizeof(path), "export");
+	if (rename(list, path) != 0) {
+		warn("%s", path);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Whether the current directory is one of those exported by the running
+ * fixture.
+ */
+static bool
+fixture_exported(void)
+{
+	char cwd[PATH_MAX], path[PATH_MAX], line[PATH_MAX + 2];
+	FILE *fp;
+	bool exported;
+
+	if (!fixture_get("mountd") || getcwd(cwd, sizeof(cwd)) == NULL)
+		return (false);
+	fixture_path(path, sizeof(path), "export");
+	if ((fp = fopen(path, "r")) == NULL)
+		return (false);
+	exported = false;
+	while (!exported && fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+		exported = strcmp(line, cwd) == 0;
+	}
+	fclose(fp);
+	return (exported);
+}
+
+/*
+ * Whether the running nfsd(8) already serves NFSv4, in which case there is
+ * no need to enable it in rc.conf(5) and restart nfsd(8).
+ */
+static bool
+nfsd_serves_v4(void)
+{
+	size_t len;
+	int maxvers;
+
+	len = sizeof(maxvers);
+	if (sysctlbyname("vfs.nfsd.server_max_nfsvers", &maxvers, &len, NULL,
+	    0) == -1)
+		return (false);
+	return (maxvers >= 4 && service_running(&svc_nfsd));
+}
+
+/*
+ * Bring up what the fixture is missing for a test case.
+ */
+static int
+fixture_bringup(bool nfsv4)
+{
+	static const char *const sysrc[] = { "sysrc",
+	    "nfsv4_server_enable=YES", NULL };
+	bool restart;
+
+	restart = false;
+	/* XXX TODO: Make the nfsv4_server_enable change temporary. */
+	if (nfsv4 && !fixture_get("nfsv4")) {
+		if (!nfsd_serves_v4()) {
+			if (run_command(sysrc) != 0)
+				return (-1);
+			/* An nfsd(8) we started has to pick the change up */
+			restart = fixture_get("started_nfsd") != 0;
+		}
+		fixture_set("nfsv4", 1);
+	}
+	if (!fixture_exported() && fixture_export() != 0)
+		return (-1);
+
+	if (restart) {
+		if (service_control(&svc_nfsd, "onerestart") != 0)
+			return (-1);
+	} else if (!fixture_get("nfsd")) {
+		if (!service_running(&svc_nfsd)) {
+			if (service_control(&svc_nfsd, "onestart") != 0)
+				return (-1);
+			fixture_set("started_nfsd", 1);
+		}
+	}
+	fixture_set("nfsd", 1);
+	return (0);
+}
+
+/*
+ * Undo fixture_bringup(), restoring the daemons as they were found.
+ */
+static void
+fixture_teardown(void)
+{
+	static const char *const state[] = { "export", "export.new",
+	    "exports", "generation", "mountd", "mountd_running", "nfsd",
+	    "nfsv4", "reaper", "started_auditd", "started_nfsd", "users" };
+	char path[PATH_MAX];
+	size_t i;
+
+	if (fixture_get("mountd_running"))
+		service_control(&svc_mountd, "restart");
+	else if (fixture_get("mountd"))
+		service_control(&svc_mountd, "onestop");
+	if (fixture_get("started_nfsd"))
+		service_control(&svc_nfsd, "onestop");
+	if (fixture_get("started_auditd"))
+		service_control(&svc_auditd, "onestop");
+	for (i = 0; i < nitems(state); i++) {
+		fixture_path(path, sizeof(path), state[i]);
+		unlink(path);
+	}
+	/* Left in place if a user still has its directory */
+	rmdir(EXPORTDIR);
+}
+
+/*
+ * Stop the reaper of the fixture, if one is waiting, before the fixture
+ * is used again. The reaper holds a lock on its state file for as long as
+ * it lives, so a pid left there by a reaper which is gone is never
+ * signalled. Called with the lock of the fixture held, which the reaper
+ * needs to take the fixture down, so it is never stopped half way.
+ */
+static void
+fixture_unreap(void)
+{
+	char path[PATH_MAX];
+	long pid;
+	int fd;
+
+	fixture_path(path, sizeof(path), "reaper");
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return;
+	if (flock(fd, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK) {
+		if ((pid = fixture_get("reaper")) > 0 &&
+		    kill((pid_t)pid, SIGTERM) == 0)
+			flock(fd, LOCK_SH);
+		else
+			warn("Unable to stop the reaper of the fixture");
+	}
+	close(fd);
+}
+
+/*
+ * Take the fixture down now or, if NFSAUDIT_FIXTURE_LINGER is set to a
+ * number of seconds, from a detached process once it has been unused for
+ * that long, and generation is still the last one handed out. The reaper
+ * keeps none of the descriptors of the caller, neither its lock nor e.g. the
+ * auditpipe or the sockets of its tests. Its pid is left in the "reaper"
+ * state file, which it keeps locked until it exits, see fixture_unreap().
+ */
+static void
+fixture_reap(long generation)
+{
+	char path[PATH_MAX];
+	const char *env;
+	long linger;
+	pid_t pid;
+	int lockfd, nullfd, reaperfd;
+
+	fixture_unreap();
+	linger = 0;
+	if ((env = getenv("NFSAUDIT_FIXTURE_LINGER")) != NULL)
+		linger = strtol(env, NULL, 10);
+	if (linger <= 0) {
+		fixture_teardown();
+		return;
+	}
+
+	fixture_path(path, sizeof(path), "reaper");
+	if ((reaperfd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+	    0600)) == -1 || flock(reaperfd, LOCK_EX | LOCK_NB) == -1) {
+		warn("%s", path);
+		if (reaperfd != -1)
+			close(reaperfd);
+		fixture_teardown();
+		return;
+	}
+
+	/*
+	 * Fork twice so that the reaper neither is a zombie of the test nor
+	 * belongs to its process group, which kyua(1) kills when the test
+	 * case is over. The lock of the state file passes on to the reaper
+	 * alone, and its pid is written before the caller goes on.
+	 */
+	if ((pid = fork()) == -1) {
+		warn("fork");
+		close(reaperfd);
+		fixture_teardown();
+		return;
+	}
+	if (pid != 0) {
+		waitpid(pid, NULL, 0);
+		close(reaperfd);
+		return;
+	}
+	if ((nullfd = open("/dev/null", O_RDWR)) != -1) {
+		dup2(nullfd, STDIN_FILENO);
+		dup2(nullfd, STDOUT_FILENO);
+		dup2(nullfd, STDERR_FILENO);
+	}
+	/* Not passed on to the daemons service(8) restarts either */
+	if (dup2(reaperfd, STDERR_FILENO + 1) == -1 ||
+	    fcntl(STDERR_FILENO + 1, F_SETFD, FD_CLOEXEC) == -1)
+		_exit(1);
+	closefrom(STDERR_FILENO + 2);
+	if (setsid() == -1 || (pid = fork()) == -1)
+		_exit(1);
+	if (pid != 0) {
+		fixture_set("reaper", (long)pid);
+		_exit(0);
+	}
+	sleep(linger);
+	if ((lockfd = fixture_lock()) == -1)
+		_exit(1);
+	if (fixture_get("users") == 0 && fixture_get("generation") == generation)
+		fixture_teardown();
+	close(lockfd);
+	_exit(0);
+}
+
+static void
+fixture_ref(void)
+{
+	fixture_set("users", fixture_get("users") + 1);
+	fixture_set("generation", fixture_get("generation") + 1);
+}
+
+/*
+ * Register a user of the NFS server fixture, bringing it up if needed.
+ * The current directory must be one made by fixture_mkdir(). Returns 0
+ * once it can be mounted from SERVER, -1 and a warning otherwise.
+ */
+int
+fixture_acquire(bool nfsv4)
+{
+	int error, lockfd;
+
+	if ((lockfd = fixture_lock()) == -1)
+		return (-1);
+	fixture_unreap();
+	if ((error = fixture_bringup(nfsv4)) == 0)
+		fixture_ref();
+	close(lockfd);
+	return (error);
+}
+
+/*
+ * Wait for the kernel to be auditing, which auditd(8) turns on once its
+ * trail is open. Returns how many milliseconds that took, -1 and a warning
+ * if it is not within timeout_ms.
+ */
+static long
+wait_auditing(long timeout_ms)
+{
+	struct timespec start;
+	long backoff;
+	int cond;
+
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &start));
+	backoff = PROBE_BACKOFF_MS;
+	for (;;) {
+		if (auditon(A_GETCOND, &cond, sizeof(cond)) == 0 &&
+		    cond == AUC_AUDITING)
+			return (elapsed_ms(&start));
+		if (elapsed_ms(&start) + backoff >= timeout_ms) {
+			warnx("auditing is not enabled after %ld ms",
+			    elapsed_ms(&start));
+			return (-1);
+		}
+		usleep((useconds_t)backoff * 1000);
+		backoff = MIN(backoff * 2, PROBE_BACKOFF_MAX_MS);
+	}
+}
+
+/*
+ * Register a user of auditd(8), which the fixture starts unless it runs
+ * already and then keeps running until its teardown. Returns how many
+ * milliseconds auditing took to be enabled, -1 and a warning on failure.
+ */
+long
+fixture_acquire_audit(void)
+{
+	long ready;
+	int lockfd;
+
+	if ((lockfd = fixture_lock()) == -1)
+		return (-1);
+	fixture_unreap();
+	ready = -1;
+	if (!service_running(&svc_auditd)) {
+		if (service_control(&svc_auditd, "onestart") != 0)
+			goto out;
+		fixture_set("started_auditd", 1);
+	}
+	if ((ready = wait_auditing(AUDITD_TIMEOUT_MS)) >= 0)
+		fixture_ref();
+out:
+	close(lockfd);
+	return (ready);
+}
+
+/*
+ * Drop a reference taken by fixture_acquire(). The last one out takes the
+ * fixture down, or leaves it to a reaper, see fixture_reap().
+ */
+void
+fixture_release(void)
+{
+	long users;
+	int lockfd;
+
+	if ((lockfd = fixture_lock()) == -1)
+		return;
+	users = fixture_get("users") - 1;
+	fixture_set("users", users > 0 ? users : 0);
+	if (users <= 0)
+		fixture_reap(fixture_get("generation"));
+	close(lockfd);
+}
+
+/*
+ * Make a directory of its own for a user of the fixture under EXPORTDIR,
+ * which fixture_acquire() exports once it is the current directory.
+ * Returns 0 and its path in 'dir', -1 and a warning on failure.
+ */
+int
+fixture_mkdir(char *dir, size_t len)
+{
+	int error, lockfd;
+
+	/* The teardown removes EXPORTDIR once it is empty */
+	if ((lockfd = fixture_lock()) == -1)
+		return (-1);
+	error = 0;
+	snprintf(dir, len, "%s/XXXXXX", EXPORTDIR);
+	if ((mkdir(EXPORTDIR, 0755) == -1 && errno != EEXIST) ||
+	    mkdtemp(dir) == NULL) {
+		warn("%s", dir);
+		error = -1;
+	}
+	close(lockfd);
+	return (error);
+}
+
+/*
+ * Remove a directory made by fixture_mkdir() and all it holds. It is left
+ * in the exports until the next user reloads them.
+ */
+void
+fixture_rmdir(const char *dir)
+{
+	const char *const rm[] = { "rm", "-rf", dir, NULL };
+	size_t len;
+	int lockfd;
+
+	len = strlen(EXPORTDIR);
+	if (strncmp(dir, EXPORTDIR, len) != 0 || dir[len] != '/' ||
+	    strchr(dir + len + 1, '/') != NULL || dir[len + 1] == '.') {
+		warnx("%s is not a directory of the fixture", dir);
+		return;
+	}
+	/* mountd(8) must not reload an exports(5) file naming it meanwhile */
+	if ((lockfd = fixture_lock()) == -1)
+		return;
+	run_command(rm);
+	close(lockfd);
+}
+#else	/* __linux__ */
+/*
+ * The fixture runs the NFS server and auditd(8) of FreeBSD. On Linux only
+ * nfs-audit-standin stands for them, and tc_workdir() skips the test cases
+ * which need the fixture.
+ */
+int
+fixture_acquire(__unused bool nfsv4)
+{
+	warnx("The NFS server fixture needs FreeBSD");
+	return (-1);
+}
+
+long
+fixture_acquire_audit(void)
+{
+	warnx("The NFS server fixture needs FreeBSD");
+	return (-1);
+}
+
+void
+fixture_release(void)
+{
+}
+
+int
+fixture_mkdir(__unused char *dir, __unused size_t len)
+{
+	warnx("The NFS server fixture needs FreeBSD");
+	return (-1);
+}
+
+void
+fixture_rmdir(__unused const char *dir)
+{
+}
+#endif	/* __linux__ */
+
+/*
+ * Move the test case into a directory of its own under the export of the
+ * NFS server fixture, which tc_body_init() mounts, so that the files it
+ * makes by their relative path are there. Its cleanup routine removes the
+ * directory. nfs-audit-standin serves the work directory itself, which is
+ * then kept.
+ */
+void
+tc_workdir(void)
+{
+#ifndef __linux__
+	char dir[PATH_MAX];
+#endif
+
+	if (standin_dir() != NULL)
+		return;
+#ifdef __linux__
+	atf_tc_skip("Only nfs-audit-standin runs on Linux, see "
+	    "NFSAUDIT_STANDIN");
+#else
+	ATF_REQUIRE(getcwd(tc_dir, sizeof(tc_dir)) != NULL);
+	ATF_REQUIRE_MSG(fixture_mkdir(dir, sizeof(dir)) == 0,
+	    "Unable to make a directory under %s", EXPORTDIR);
+	atf_utils_create_file("fixture_workdir", "%s\n", dir);
+	ATF_REQUIRE_EQ_MSG(0, chdir(dir), "%s: %s", dir, strerror(errno));
+#endif
+}
+
+void
+cleanup(void)
+{
+	char dir[PATH_MAX];
+	FILE *fp;
+
+	/* If 'fixture_workdir' exists, it names the test case's export */
+	if ((fp = fopen("fixture_workdir", "r")) != NULL) {
+		if (fgets(dir, sizeof(dir), fp) != NULL) {
+			dir[strcspn(dir, "\n")] = '\0';
+			fixture_rmdir(dir);
+		}
+		fclose(fp);
+	}
+	/* If 'audit_acquired' exists, the test case uses auditd(8) */
+	if (atf_utils_file_exists("audit_acquired"))
+		fixture_release();
+	/* If 'fixture_acquired' exists, the test case uses the NFS fixture */
+	if (atf_utils_file_exists("fixture_acquired"))
+		fixture_release();
+	/* If 'standin_stalled' exists, nfs-audit-standin stalls its replies */
+	if (atf_utils_file_exists("standin_stalled") && standin_dir() != NULL)
+		standin_stall(0);
+}
+
+/* Time limit for the NFS server to answer the readiness probe */
+#define	PROBE_TIMEOUT_MS	10000
+
+/*
+ * The RPC services the NFS server needs, probed in this order with their
+ * NULL procedure.
+ */
+static const struct probe_target {
+	const char	*name;
+	int		program;
+	int		version;
+	int		(*null_async)(struct rpc_context *, rpc_cb, void *);
+} probe_targets[] = {
+	{ "rpcbind", PMAP_PROGRAM, PMAP_V2, rpc_pmap2_null_async },
+	{ "mountd", MOUNT_PROGRAM, MOUNT_V3, rpc_mount3_null_async },
+	{ "nfsd", NFS_PROGRAM, NFS_V3, rpc_nfs3_null_async },
+	{ "nfsd", NFS4_PROGRAM, NFS_V4, rpc_nfs4_null_async },
+};
+
+struct probe_call {
+	int	done;
+	int	status;
+};
+
+static void
+probe_cb(__unused struct rpc_context *rpc, int status, __unused void *data,
+    void *private_data)
+{
+	struct probe_call *call;
+
+	call = private_data;
+	call->status = status;
+	call->done = 1;
+}
+
+/*
+ * Service rpc until call completes or timeout_ms have elapsed since start.
+ * Returns 0 if the call succeeded.
+ */
+static int
+probe_wait(struct rpc_context *rpc, struct probe_call *call,
+    const struct timespec *start, long timeout_ms)
+{
+	struct pollfd pfd;
+	long left;
+
+	while (!call->done) {
+		if ((left = timeout_ms - elapsed_ms(start)) <= 0)
+			return (-1);
+		pfd.fd = rpc_get_fd(rpc);
+		pfd.events = rpc_which_events(rpc);
+		if (poll(&pfd, 1, (int)left) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		if (rpc_service(rpc, pfd.revents) < 0)
+			return (-1);
+	}
+	return (call->status == RPC_STATUS_SUCCESS ? 0 : -1);
+}
+
+/*
+ * Connect to the service through rpcbind(8) and call its NULL procedure.
+ */
+static int
+probe_service(const struct probe_target *target, const struct timespec *start,
+    long timeout_ms)
+{
+	struct rpc_context *rpc;
+	struct probe_call call;
+	int error;
+
+	if ((rpc = rpc_init_context()) == NULL)
+		return (-1);
+	call.done = 0;
+	error = rpc_connect_program_async(rpc, SERVER, target->program,
+	    target->version, probe_cb, &call);
+	if (error == 0)
+		error = probe_wait(rpc, &call, start, timeout_ms);
+	if (error == 0) {
+		call.done = 0;
+		error = target->null_async(rpc, probe_cb, &call);
+		if (error == 0)
+			error = probe_wait(rpc, &call, start, timeout_ms);
+	}
+	rpc_destroy_context(rpc);
+	return (error);
+}
+
+/*
+ * Wait for rpcbind(8), mountd(8) and nfsd(8) on SERVER to answer a NULL
+ * call, backing off exponentially between attempts. Returns how many
+ * milliseconds the server took to become ready, -1 and a warning if it is
+ * not ready within timeout_ms.
+ */
+long
+nfs_probe(bool nfsv4, long timeout_ms)
+{
+	const struct probe_target *target;
+	struct timespec start;
+	long backoff;
+	size_t i;
+
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &start));
+	backoff = PROBE_BACKOFF_MS;
+	for (i = 0; i < nitems(probe_targets); ) {
+		target = &probe_targets[i];
+		if (target->program == NFS_PROGRAM &&
+		    (target->version == NFS_V4) != nfsv4) {
+			i++;
+			continue;
+		}
+		if (probe_service(target, &start, timeout_ms) == 0) {
+			i++;
+			continue;
+		}
+		if (elapsed_ms(&start) + backoff >= timeout_ms) {
+			warnx("%s is not ready after %ld ms", target->name,
+			    elapsed_ms(&start));
+			return (-1);
+		}
+		usleep((useconds_t)backoff * 1000);
+		backoff = MIN(backoff * 2, PROBE_BACKOFF_MAX_MS);
+	}
+	return (elapsed_ms(&start));
+}
+
+/*
+ * Point nfs at the port of nfs-audit-standin for both MOUNT and NFS, if it
+ * is the server. Returns -1 if it is but its port cannot be read.
+ */
+static int
+standin_ports(struct nfs_context *nfs)
+{
+	const char *dir;
+	char path[PATH_MAX];
+	FILE *portfile;
+	int port;
+
+	if ((dir = standin_dir()) == NULL)
+		return (0);
+	snprintf(path, sizeof(path), "%s/%s", dir, STANDIN_PORT);
+	if ((portfile = fopen(path, "r")) == NULL)
+		return (-1);
+	if (fscanf(portfile, "%d", &port) != 1)
+		port = -1;
+	fclose(portfile);
+	if (port <= 0)
+		return (-1);
+	nfs_set_mountport(nfs, port);
+	nfs_set_nfsport(nfs, port);
+	return (0);
+}
+
+/*
+ * Have nfs-audit-standin hold every NFSv3 reply back for 'ms', or no more
+ * if 0, as a stalled server would. The test case is skipped unless it runs
+ * against the stand-in, and its cleanup routine lifts the stall.
+ */
+void
+standin_stall(long ms)
+{
+	const char *dir;
+	char path[PATH_MAX], tmp[PATH_MAX];
+	FILE *stallfile;
+
+	if ((dir = standin_dir()) == NULL)
+		atf_tc_skip("Only nfs-audit-standin can stall its replies, see "
+		    "NFSAUDIT_STANDIN");
+	snprintf(path, sizeof(path), "%s/%s", dir, STANDIN_STALL);
+	if (ms == 0) {
+		ATF_REQUIRE_MSG(unlink(path) == 0 || errno == ENOENT,
+		    "%s: %s", path, strerror(errno));
+		return;
+	}
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	ATF_REQUIRE_MSG((stallfile = fopen(tmp, "w")) != NULL, "%s: %s", tmp,
+	    strerror(errno));
+	fprintf(stallfile, "%ld\n", ms);
+	ATF_REQUIRE_EQ(0, fclose(stallfile));
+	ATF_REQUIRE_MSG(rename(tmp, path) == 0, "%s: %s", path,
+	    strerror(errno));
+	atf_utils_create_file("standin_stalled", "%s", "");
+}
+
+struct nfs_context
+*tc_body_init(int au_rpc_event, struct au_rpc_data* au_test_data)
+{
+	struct nfs_context *nfs;
+	struct nfs_url url;
+	char cwd[PATH_MAX + 1], path[PATH_MAX];
+	long ready;
+	int error;
+
+	nfs = nfs_init_context();
+	ATF_REQUIRE(nfs != NULL);
+	au_rpc_init(au_test_data, au_rpc_event);
+
+	if (au_rpc_event >= AUE_NFSV4RPC_COMPOUND)
+		ATF_REQUIRE_EQ(0, nfs_set_version(nfs, NFS_V4));
+
+	/* nfs-audit-standin serves the work directory by itself */
+	if (standin_dir() != NULL) {
+		if (au_rpc_event >= AUE_NFSV4RPC_COMPOUND)
+			atf_tc_skip("nfs-audit-standin does not serve NFSv4 "
+			    "yet, see Design");
+		ATF_REQUIRE_MSG(standin_ports(nfs) == 0,
+		    "nfs-audit-standin is not running");
+		ATF_REQUIRE(getcwd(cwd, PATH_MAX) != NULL);
+		error = nfs_mount(nfs, SERVER, cwd);
+		ATF_REQUIRE_EQ_MSG(error, 0, "nfs_mount: %d, %s", -error,
+		    strerror(-error));
+		return (nfs);
+	}
+
+	/*
+	 * The directory of tc_workdir() is mounted from the NFS server
+	 * fixture shared with the other test cases, see fixture_acquire().
+	 */
+	ATF_REQUIRE_MSG(tc_dir[0] != '\0',
+	    "tc_workdir() must come first in the test case");
+	ATF_REQUIRE_EQ_MSG(0,
+	    fixture_acquire(au_rpc_event >= AUE_NFSV4RPC_COMPOUND),
+	    "Unable to bring up the NFS server fixture");
+	atf_utils_create_file(tc_file(path, sizeof(path), "fixture_acquired"),
+	    "%s", "");
+	ATF_REQUIRE(getcwd(cwd, PATH_MAX) != NULL);
+
+	url.server = SERVER;
+	url.path = cwd;
+
+	/*
+	 * nfs_mount() fails if nfsd(8) or mountd(8) are not accepting calls
+	 * yet, which is the case for a while after they were started.
+	 */
+	ready = nfs_probe(au_rpc_event >= AUE_NFSV4RPC_COMPOUND,
+	    PROBE_TIMEOUT_MS);
+	ATF_REQUIRE_MSG(ready >= 0, "NFS server is not ready");
+	record_stat("nfs", "ready_ms", (uintmax_t)ready);
+
+	error = nfs_mount(nfs, url.server, url.path);
+	ATF_REQUIRE_EQ_MSG(error, 0, "nfs_mount: %d, %s",-error, strerror(-error));
+
+	return nfs;
+}
+
+/*
+ * Service the rpc context of nfs until the 'n' RPCs of au_test_data, all
+ * in flight on it at once, complete or 'timeout_ms' pass, -1 for no limit.
+ * The replies come back in any order, each through the callback of its
+ * own entry. Returns how many are still in flight, -1 if the connection
+ * failed first.
+ */
+int
+nfs_wait_rpcs(struct nfs_context *nfs, struct au_rpc_data au_test_data[],
+    int n, long timeout_ms)
+{
+	struct pollfd pfd;
+	struct rpc_context *rpc = nfs_get_rpc_context(nfs);
+	struct timespec start;
+	long left;
+	int i, pending;
+
+	ATF_REQUIRE_EQ(0, clock_gettime(CLOCK_MONOTONIC, &start));
+	for (;;) {
+		for (pending = 0, i = 0; i < n; i++)
+			pending += !au_test_data[i].is_finished;
+		if (pending == 0)
+			return (0);
+		left = -1;
+		if (timeout_ms >= 0 &&
+		    (left = timeout_ms - elapsed_ms(&start)) <= 0)
+			return (pending);
+
+		pfd.fd = rpc_get_fd(rpc);
+		pfd.events = rpc_which_events(rpc);
+		if (poll(&pfd, 1, (int)left) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		if (pfd.revents != 0 && rpc_service(rpc, pfd.revents) < 0)
+			return (-1);
+	}
+}
+
+/*
+ * Time limit for the reply to an RPC, NFSAUDIT_RPC_TIMEOUT_MS or
+ * RPC_TIMEOUT_MS, well within the timeout kyua gives a test case.
+ */
+static long
+rpc_timeout_ms(void)
+{
+	const char *timeout;
+	long ms;
+
+	if ((timeout = getenv("NFSAUDIT_RPC_TIMEOUT_MS")) != NULL &&
+	    (ms = strtol(timeout, NULL, 10)) > 0)
+		return (ms);
+	return (RPC_TIMEOUT_MS);
+}
+
+/*
+ * Service the rpc context of nfs until the RPC of au_test_data completes
+ * or its deadline, see rpc_timeout_ms(), passes. Returns 0 once it did, 1
+ * if the deadline passed and -1 if the connection failed first.
+ */
+int
+nfs_wait_rpc(struct nfs_context *nfs, struct au_rpc_data *au_test_data)
+{
+	return (nfs_wait_rpcs(nfs, au_test_data, 1, rpc_timeout_ms()));
+}
+
+/*
+ * Unmount nfs and free it.
+ */
+void
+nfs_teardown(struct nfs_context *nfs)
+{
+	nfs_umount(nfs);
+	rpc_destroy_context(nfs->rpc);
+	nfs->rpc = NULL;
+	free(nfs);
+}
+
+/*
+ * Free nfs without unmounting it, which would wait on a server that may
+ * not answer any more.
+ */
+void
+nfs_abandon(struct nfs_context *nfs)
+{
+	rpc_destroy_context(nfs->rpc);
+	nfs->rpc = NULL;
+	free(nfs);
+}
+
+int
+nfs_poll_fd(struct nfs_context *nfs, struct au_rpc_data *au_test_data)
+{
+	long timeout = rpc_timeout_ms();
+	int pending;
+
+	if ((pending = nfs_wait_rpcs(nfs, au_test_data, 1, timeout)) == -1)
+		atf_tc_fail("rpc_service failed: %s", nfs_get_error(nfs));
+	if (pending != 0) {
+		nfs_cancel_rpcs(nfs, au_test_data, 1);
+		nfs_abandon(nfs);
+		atf_tc_fail("No reply to the RPC of event %d within %ld ms",
+		    au_test_data->au_rpc_event, timeout);
+	}
+	nfs_teardown(nfs);
+
+	return au_test_data->au_rpc_status;
+}
+
+/*
+ * Get au_test_data ready for the next RPC of au_rpc_event.
+ */
+void
+au_rpc_init(struct au_rpc_data *au_test_data, int au_rpc_event)
+{
+	au_test_data->au_rpc_event = au_rpc_event;
+	au_test_data->au_rpc_status = -1;
+	au_test_data->au_rpc_result = -1;
+	au_test_data->is_finished = 0;
+	memset(&au_test_data->submitted, 0, sizeof(au_test_data->submitted));
+	memset(&au_test_data->completed, 0, sizeof(au_test_data->completed));
+}
+
+/*
+ * Stamp the RPC of au_test_data as submitted if its rpc_*_async() call
+ * returned "error" 0, as it was queued then, which is where its latency is
+ * measured from. Returns error, see AU_RPC_ASYNC().
+ */
+int
+au_rpc_issued(struct au_rpc_data *au_test_data, int error)
+{
+	if (error == 0)
+		clock_gettime(CLOCK_MONOTONIC, &au_test_data->submitted);
+	return (error);
+}
+
+/*
+ * Latency of the RPCs of each NFS event, from submission to the callback,
+ * in log-linear buckets like an HDR histogram: exact below 2^LAT_SUBBITS
+ * ns, then LAT_SUBBUCKETS per power of two, within about 6% of the value.
+ * The percentiles go to the statistics file when the test exits.
+ */
+#define	LAT_EVENT_FIRST		AUE_NFS3RPC_GETATTR
+#define	LAT_EVENT_LAST		AUE_NFSV4OP_REMOVEXATTR
+#define	LAT_NEVENTS		(LAT_EVENT_LAST - LAT_EVENT_FIRST + 1)
+#define	LAT_SUBBITS		5
+#define	LAT_SUBBUCKETS		(1 << (LAT_SUBBITS - 1))
+#define	LAT_NBUCKETS		((64 - LAT_SUBBITS + 2) * LAT_SUBBUCKETS)
+
+struct latency_hist {
+	uint64_t	count;
+	uint64_t	timeouts;	/* RPCs cancelled, not in the buckets */
+	uint64_t	max;
+	uint64_t	buckets[LAT_NBUCKETS];
+};
+
+static pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct latency_hist *latency[LAT_NEVENTS];
+
+static u_int
+latency_bucket(uint64_t ns)
+{
+	u_int shift;
+
+	if (ns < (1 << LAT_SUBBITS))
+		return ((u_int)ns);
+	shift = flsll((long long)ns) - LAT_SUBBITS;
+	return (shift * LAT_SUBBUCKETS + (u_int)(ns >> shift));
+}
+
+/* Highest value which falls in bucket 'i' */
+static uint64_t
+latency_value(u_int i)
+{
+	u_int shift;
+
+	if (i < (1 << LAT_SUBBITS))
+		return (i);
+	shift = i / LAT_SUBBUCKETS - 1;
+	return (((uint64_t)(i % LAT_SUBBUCKETS + LAT_SUBBUCKETS + 1) <<
+	    shift) - 1);
+}
+
+static uint64_t
+latency_percentile(const struct latency_hist *hist, double pct)
+{
+	uint64_t rank, seen;
+	u_int i;
+
+	rank = (uint64_t)(hist->count * pct / 100.0 + 0.5);
+	if (rank == 0)
+		rank = 1;
+	for (seen = 0, i = 0; i < LAT_NBUCKETS; i++) {
+		if ((seen += hist->buckets[i]) >= rank)
+			return (MIN(latency_value(i), hist->max));
+	}
+	return (hist->max);
+}
+
+/*
+ * Summary of the latencies of the RPCs of 'event', or of all of them for
+ * RPC_LATENCY_ANY, completed since the start or rpc_latency_reset().
+ * Returns false if there were none.
+ */
+bool
+rpc_latency_get(int event, struct rpc_latency *lat)
+{
+	static struct latency_hist merged;
+	const struct latency_hist *hist;
+	int i;
+	u_int j;
+
+	if (event != RPC_LATENCY_ANY &&
+	    (event < LAT_EVENT_FIRST || event > LAT_EVENT_LAST))
+		return (false);
+	pthread_mutex_lock(&latency_lock);
+	if (event == RPC_LATENCY_ANY) {
+		memset(&merged, 0, sizeof(merged));
+		for (i = 0; i < LAT_NEVENTS; i++) {
+			if (latency[i] == NULL)
+				continue;
+			merged.count += latency[i]->count;
+			merged.timeouts += latency[i]->timeouts;
+			merged.max = MAX(merged.max, latency[i]->max);
+			for (j = 0; j < LAT_NBUCKETS; j++)
+				merged.buckets[j] += latency[i]->buckets[j];
+		}
+		hist = &merged;
+	} else
+		hist = latency[event - LAT_EVENT_FIRST];
+	if (hist != NULL && hist->count == 0 && hist->timeouts == 0)
+		hist = NULL;
+	if (hist != NULL) {
+		lat->count = hist->count;
+		lat->timeouts = hist->timeouts;
+		lat->p50 = latency_percentile(hist, 50);
+		lat->p99 = latency_percentile(hist, 99);
+		lat->p999 = latency_percentile(hist, 99.9);
+		lat->max = hist->max;
+	}
+	pthread_mutex_unlock(&latency_lock);
+	return (hist != NULL);
+}
+
+/*
+ * Forget the latencies recorded so far, between the runs of a benchmark.
+ */
+void
+rpc_latency_reset(void)
+{
+	int i;
+
+	pthread_mutex_lock(&latency_lock);
+	for (i = 0; i < LAT_NEVENTS; i++) {
+		if (latency[i] != NULL)
+			memset(latency[i], 0, sizeof(*latency[i]));
+	}
+	pthread_mutex_unlock(&latency_lock);
+}
+
+/* Two-sided 97.5% quantiles of Student's t for 1 to 30 degrees of freedom */
+static const double student_t[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+/*
+ * Mean and half-width of the 95% confidence interval of 'n' samples, such
+ * as the differences between the audited and unaudited runs of the rounds
+ * of a benchmark. The half-width is 0 for a single sample.
+ */
+void
+mean_confidence(const double x[], int n, double *mean, double *half)
+{
+	double sum, var;
+	int i;
+
+	for (sum = 0, i = 0; i < n; i++)
+		sum += x[i];
+	*mean = sum / n;
+	*half = 0;
+	if (n < 2)
+		return;
+	for (var = 0, i = 0; i < n; i++)
+		var += (x[i] - *mean) * (x[i] - *mean);
+	var /= n - 1;
+	*half = (n - 1 <= (int)nitems(student_t) ? student_t[n - 2] : 1.96) *
+	    sqrt(var / n);
+}
+
+static void
+latency_report(void)
+{
+	struct rpc_latency lat;
+	struct au_event_ent *ev;
+	char prefix[64];
+	int event;
+
+	for (event = LAT_EVENT_FIRST; event <= LAT_EVENT_LAST; event++) {
+		if (!rpc_latency_get(event, &lat))
+			continue;
+		if ((ev = getauevnum(event)) != NULL)
+			snprintf(prefix, sizeof(prefix), "latency.%s",
+			    ev->ae_name);
+		else
+			snprintf(prefix, sizeof(prefix), "latency.%d", event);
+		record_stat(prefix, "count", lat.count);
+		record_stat(prefix, "timeouts", lat.timeouts);
+		record_stat(prefix, "p50_ns", lat.p50);
+		record_stat(prefix, "p99_ns", lat.p99);
+		record_stat(prefix, "p999_ns", lat.p999);
+		record_stat(prefix, "max_ns", lat.max);
+	}
+}
+
+/*
+ * The histogram of 'event', allocated on first use. Called with
+ * latency_lock held. Returns NULL if it cannot be allocated.
+ */
+static struct latency_hist *
+latency_hist(int event)
+{
+	static bool registered;
+	struct latency_hist **hist;
+
+	hist = &latency[event - LAT_EVENT_FIRST];
+	if (*hist == NULL && (*hist = calloc(1, sizeof(**hist))) != NULL &&
+	    !registered)
+		registered = atexit(latency_report) == 0;
+	return (*hist);
+}
+
+/*
+ * Take the completion time of the RPC of au_test_data and add its latency
+ * to the histogram of its event. RPCs which got no reply are counted by
+ * nfs_cancel_rpcs() instead. One not issued with AU_RPC_ASYNC() has no
+ * submission time and is left out, with a warning the first time.
+ */
+static void
+latency_record(struct au_rpc_data *au_test_data, int status)
+{
+	static bool warned;
+	struct latency_hist *hist;
+	int event = au_test_data->au_rpc_event;
+	uint64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &au_test_data->completed);
+	if (status != RPC_STATUS_SUCCESS ||
+	    event < LAT_EVENT_FIRST || event > LAT_EVENT_LAST)
+		return;
+	if (au_test_data->submitted.tv_sec == 0 &&
+	    au_test_data->submitted.tv_nsec == 0) {
+		pthread_mutex_lock(&latency_lock);
+		if (!warned)
+			warnx("RPC of event %d was not stamped as submitted, "
+			    "see AU_RPC_ASYNC(); its latency is not recorded",
+			    event);
+		warned = true;
+		pthread_mutex_unlock(&latency_lock);
+		return;
+	}
+	ns = (uint64_t)(au_test_data->completed.tv_sec -
+	    au_test_data->submitted.tv_sec) * 1000000000 +
+	    (uint64_t)(au_test_data->completed.tv_nsec -
+	    au_test_data->submitted.tv_nsec);
+
+	pthread_mutex_lock(&latency_lock);
+	if ((hist = latency_hist(event)) != NULL) {
+		hist->count++;
+		hist->max = MAX(hist->max, ns);
+		hist->buckets[latency_bucket(ns)]++;
+	}
+	pthread_mutex_unlock(&latency_lock);
+}
+
+static void
+latency_timeout(int event)
+{
+	struct latency_hist *hist;
+
+	if (event < LAT_EVENT_FIRST || event > LAT_EVENT_LAST)
+		return;
+	pthread_mutex_lock(&latency_lock);
+	if ((hist = latency_hist(event)) != NULL)
+		hist->timeouts++;
+	pthread_mutex_unlock(&latency_lock);
+}
+
+/*
+ * Give up on the RPCs of au_test_data still in flight on nfs, as their
+ * deadline passed: each is finished with RPC_STATUS_TIMEOUT and counted
+ * in the statistics of its event. The context is disconnected so that no
+ * late reply reaches a callback, and can then only be released with
+ * nfs_abandon() or nfs_pool_discard(). Returns how many were cancelled.
+ */
+int
+nfs_cancel_rpcs(struct nfs_context *nfs, struct au_rpc_data au_test_data[],
+    int n)
+{
+	bool pending[n];
+	int cancelled, i;
+
+	for (i = 0; i < n; i++)
+		pending[i] = !au_test_data[i].is_finished;
+	/* Calls back every RPC in flight with an error */
+	rpc_disconnect(nfs_get_rpc_context(nfs), "RPC deadline passed");
+	for (cancelled = 0, i = 0; i < n; i++) {
+		if (!pending[i])
+			continue;
+		au_test_data[i].au_rpc_status = RPC_STATUS_TIMEOUT;
+		au_test_data[i].au_rpc_result = -1;
+		au_test_data[i].is_finished = 1;
+		latency_timeout(au_test_data[i].au_rpc_event);
+		cancelled++;
+	}
+	return (cancelled);
+}
+
+/*
+ * Contexts mounted on the same export of SERVER. A context is checked out
+ * to issue RPCs with nfs_wait_rpc() and checked back in still mounted, so
+ * that its next user skips the TCP connect, the MOUNT and, for NFSv4, the
+ * SETCLIENTID.
+ */
+struct nfs_pool {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cv;
+	char			*path;
+	int			version;
+	u_int			maxctx;
+	u_int			nctx;	/* contexts mounted by the pool */
+	u_int			nidle;
+	struct nfs_context	**idle;
+};
+
+/*
+ * Create a pool of at most maxctx contexts mounting path with NFS version.
+ * Contexts are mounted on demand by nfs_pool_get().
+ */
+struct nfs_pool *
+nfs_pool_create(const char *path, int version, u_int maxctx)
+{
+	struct nfs_pool *pool;
+
+	if ((pool = calloc(1, sizeof(*pool))) == NULL)
+		return (NULL);
+	pool->version = version;
+	pool->maxctx = maxctx;
+	if ((pool->path = strdup(path)) == NULL ||
+	    (pool->idle = calloc(maxctx, sizeof(*pool->idle))) == NULL) {
+		free(pool->path);
+		free(pool);
+		return (NULL);
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cv, NULL);
+	return (pool);
+}
+
+static struct nfs_context *
+nfs_pool_mount(struct nfs_pool *pool)
+{
+	struct nfs_context *nfs;
+	int error;
+
+	if ((nfs = nfs_init_context()) == NULL) {
+		warnx("nfs_init_context failed");
+		return (NULL);
+	}
+	if (standin_ports(nfs) != 0)
+		error = -ENOENT;
+	else if ((error = nfs_set_version(nfs, pool->version)) == 0)
+		error = nfs_mount(nfs, SERVER, pool->path);
+	if (error != 0) {
+		warnx("nfs_mount %s:%s: %s", SERVER, pool->path,
+		    nfs_get_error(nfs));
+		nfs_destroy_context(nfs);
+		return (NULL);
+	}
+	return (nfs);
+}
+
+/*
+ * Check a mounted context out of the pool, mounting a new one if none is
+ * idle. Waits for a context to be checked in once maxctx are in use.
+ * Returns NULL and a warning if a new context cannot be mounted.
+ */
+struct nfs_context *
+nfs_pool_get(struct nfs_pool *pool)
+{
+	struct nfs_context *nfs;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->nidle == 0 && pool->nctx == pool->maxctx)
+		pthread_cond_wait(&pool->cv, &pool->lock);
+	if (pool->nidle > 0) {
+		nfs = pool->idle[--pool->nidle];
+		pthread_mutex_unlock(&pool->lock);
+		return (nfs);
+	}
+	pool->nctx++;
+	pthread_mutex_unlock(&pool->lock);
+
+	if ((nfs = nfs_pool_mount(pool)) == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		pool->nctx--;
+		pthread_cond_signal(&pool->cv);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return (nfs);
+}
+
+/*
+ * Check nfs back in, still mounted. It may also be a context mounted on
+ * the same export by tc_body_init(), which the pool then keeps if it has
+ * room for it.
+ */
+void
+nfs_pool_put(struct nfs_pool *pool, struct nfs_context *nfs)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (pool->nidle == pool->maxctx) {
+		pthread_mutex_unlock(&pool->lock);
+		nfs_teardown(nfs);
+		return;
+	}
+	pool->idle[pool->nidle++] = nfs;
+	pthread_cond_signal(&pool->cv);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Free a checked out context which is no longer usable, e.g. after
+ * nfs_wait_rpc() failed on it or its RPCs were cancelled. It is not
+ * unmounted, see nfs_abandon().
+ */
+void
+nfs_pool_discard(struct nfs_pool *pool, struct nfs_context *nfs)
+{
+	nfs_abandon(nfs);
+	pthread_mutex_lock(&pool->lock);
+	if (pool->nctx > 0)
+		pool->nctx--;
+	pthread_cond_signal(&pool->cv);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Tear down the idle contexts and free the pool. All the contexts must
+ * have been checked in.
+ */
+void
+nfs_pool_destroy(struct nfs_pool *pool)
+{
+	while (pool->nidle > 0)
+		nfs_teardown(pool->idle[--pool->nidle]);
+	pthread_cond_destroy(&pool->cv);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->idle);
+	free(pool->path);
+	free(pool);
+}
+
+/*
+ * One kqueue(2), or epoll(7) on Linux where only nfs-audit-standin runs,
+ * over any number of mounted contexts and the auditpipe of setup().
+ * A single thread then services the RPCs in flight on all of them and
+ * checks the records they cause as both arrive, instead of waiting for
+ * the RPCs first and reading the auditpipe afterwards.
+ */
+#define	LOOP_PIPE	UINT32_MAX	/* ident of the auditpipe */
+#define	LOOP_MAXEVENTS	64
+
+struct nfs_loop_ctx {
+	struct nfs_context	*nfs;
+	int			fd;	/* fd registered, -1 if none or gone */
+	int			events;	/* POLL* events registered */
+};
+
+struct nfs_loop {
+	int			qfd;
+	struct au_pipe		*aupipe;
+	struct nfs_loop_ctx	*ctx;
+	u_int			nctx;
+	u_int			maxctx;
+};
+
+/*
+ * Register fd for the POLL* events, under ident, "added" if it is thought
+ * to be in the queue already. A context gets a new fd when it reconnects,
+ * the old one left the queue as it was closed, and the new one often has
+ * the same number. Either way, the guess is corrected by the queue.
+ */
+static int
+loop_watch(struct nfs_loop *loop, uint32_t ident, int fd, int events,
+    bool added)
+{
+#ifdef __linux__
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = ((events & POLLIN) ? EPOLLIN : 0) |
+	    ((events & POLLOUT) ? EPOLLOUT : 0);
+	ev.data.u32 = ident;
+	if (epoll_ctl(loop->qfd, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+	    &ev) == 0)
+		return (0);
+	if (added && errno == ENOENT)
+		return (epoll_ctl(loop->qfd, EPOLL_CTL_ADD, fd, &ev));
+	if (!added && errno == EEXIST)
+		return (epoll_ctl(loop->qfd, EPOLL_CTL_MOD, fd, &ev));
+	return (-1);
+#else
+	struct kevent kev[2];
+
+	(void)added;
+	EV_SET(&kev[0], fd, EVFILT_READ,
+	    EV_ADD | ((events & POLLIN) ? EV_ENABLE : EV_DISABLE), 0, 0,
+	    (void *)(uintptr_t)ident);
+	EV_SET(&kev[1], fd, EVFILT_WRITE,
+	    EV_ADD | ((events & POLLOUT) ? EV_ENABLE : EV_DISABLE), 0, 0,
+	    (void *)(uintptr_t)ident);
+	return (kevent(loop->qfd, kev, nitems(kev), NULL, 0, NULL));
+#endif
+}
+
+/*
+ * Drop the registration of fd, which the context it was registered for
+ * replaced without closing it. Errors are ignored, as it may have left the
+ * queue already.
+ */
+static void
+loop_unwatch(struct nfs_loop *loop, int fd)
+{
+#ifdef __linux__
+	epoll_ctl(loop->qfd, EPOLL_CTL_DEL, fd, NULL);
+#else
+	struct kevent kev[2];
+
+	EV_SET(&kev[0], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	EV_SET(&kev[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	kevent(loop->qfd, kev, nitems(kev), NULL, 0, NULL);
+#endif
+}
+
+/*
+ * Whether the registration of fd, formerly that of context c, is stale: fd
+ * is still open and neither the auditpipe nor another context uses it. An
+ * fd closed by libnfs left the queue by itself, and its number may be
+ * reused by the time it is looked at.
+ */
+static bool
+loop_stale(struct nfs_loop *loop, u_int c, int fd)
+{
+	u_int i;
+
+	if (fd < 0 || fcntl(fd, F_GETFD) == -1)
+		return (false);
+	if (loop->aupipe != NULL && loop->aupipe->framer.fd == fd)
+		return (false);
+	for (i = 0; i < loop->nctx; i++) {
+		if (i != c && loop->ctx[i].fd == fd)
+			return (false);
+	}
+	return (true);
+}
+
+/*
+ * Wait up to timeout_ms, -1 for ever, for events. Returns how many, with
+ * the ident and the POLL* events of each. The EOF of a socket is only
+ * passed on once the replies before it have been read.
+ */
+static int
+loop_wait(struct nfs_loop *loop, uint32_t idents[], int revents[],
+    long timeout_ms)
+{
+	int i, n;
+#ifdef __linux__
+	struct epoll_event ev[LOOP_MAXEVENTS];
+
+	if ((n = epoll_wait(loop->qfd, ev, LOOP_MAXEVENTS,
+	    (int)timeout_ms)) == -1)
+		return (-1);
+	for (i = 0; i < n; i++) {
+		idents[i] = ev[i].data.u32;
+		revents[i] = ((ev[i].events & EPOLLIN) ? POLLIN : 0) |
+		    ((ev[i].events & EPOLLOUT) ? POLLOUT : 0) |
+		    ((ev[i].events & EPOLLHUP) ? POLLHUP : 0) |
+		    ((ev[i].events & EPOLLERR) ? POLLERR : 0);
+	}
+#else
+	struct kevent kev[LOOP_MAXEVENTS];
+	struct timespec ts;
+
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = timeout_ms % 1000 * 1000000;
+	if ((n = kevent(loop->qfd, NULL, 0, kev, LOOP_MAXEVENTS,
+	    timeout_ms < 0 ? NULL : &ts)) == -1)
+		return (-1);
+	for (i = 0; i < n; i++) {
+		idents[i] = (uint32_t)(uintptr_t)kev[i].udata;
+		revents[i] = kev[i].filter == EVFILT_READ ? POLLIN : POLLOUT;
+		if ((kev[i].flags & EV_EOF) &&
+		    (kev[i].filter == EVFILT_WRITE || kev[i].data == 0))
+			revents[i] |= POLLHUP;
+		if (kev[i].flags & EV_ERROR)
+			revents[i] = POLLERR;
+	}
+#endif
+	return (n);
+}
+
+/*
+ * Create a loop over the auditpipe of setup(), or none if aupipe is NULL.
+ * Returns NULL and a warning on failure.
+ */
+struct nfs_loop *
+nfs_loop_create(struct au_pipe *aupipe)
+{
+	struct nfs_loop *loop;
+
+	if ((loop = calloc(1, sizeof(*loop))) == NULL) {
+		warn("calloc");
+		return (NULL);
+	}
+#ifdef __linux__
+	loop->qfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+	loop->qfd = kqueue();
+#endif
+	if (loop->qfd == -1) {
+		warn("event queue");
+		free(loop);
+		return (NULL);
+	}
+	loop->aupipe = aupipe;
+	if (aupipe != NULL && loop_watch(loop, LOOP_PIPE, aupipe->framer.fd,
+	    POLLIN, false) == -1) {
+		warn("auditpipe");
+		nfs_loop_destroy(loop);
+		return (NULL);
+	}
+	return (loop);
+}
+
+/*
+ * Add a mounted context to the loop. It still belongs to the caller.
+ */
+int
+nfs_loop_add(struct nfs_loop *loop, struct nfs_context *nfs)
+{
+	struct nfs_loop_ctx *ctx;
+	u_int maxctx;
+
+	if (loop->nctx == loop->maxctx) {
+		maxctx = loop->maxctx == 0 ? 16 : loop->maxctx * 2;
+		if ((ctx = reallocarray(loop->ctx, maxctx,
+		    sizeof(*ctx))) == NULL)
+			return (-1);
+		loop->ctx = ctx;
+		loop->maxctx = maxctx;
+	}
+	ctx = &loop->ctx[loop->nctx++];
+	ctx->nfs = nfs;
+	ctx->fd = -1;
+	ctx->events = 0;
+	return (0);
+}
+
+void
+nfs_loop_destroy(struct nfs_loop *loop)
+{
+	close(loop->qfd);
+	free(loop->ctx);
+	free(loop);
+}
+
+/*
+ * Check the records framed so far against the expected ones. Returns -1 if a record is malformed, or with ENOBUFS
+ * if the auditpipe dropped records since setup(), as check_auditpipe() fails.
+ */
+static int
+loop_records(struct nfs_loop *loop, const struct au_match *matches,
+    bool found[], int nmatch)
+{
+	struct au_pipe *aupipe = loop->aupipe;
+	struct au_pipe_stats stats;
+	u_char *buff;
+	size_t reclen;
+	int error, i;
+
+	get_pipe_stats(aupipe, &stats);
+	if (stats.drops > aupipe->before.drops) {
+		errno = ENOBUFS;
+		return (-1);
+	}
+	while ((error = au_framer_next(&aupipe->framer, &buff,
+	    &reclen)) == 1) {
+		i = au_match_next(matches, found, nmatch, false,
+		    &aupipe->arena, buff, reclen);
+		if (i == -2)
+			return (-1);
+		if (i >= 0)
+			found[i] = true;
+	}
+	return (error == -1 ? -1 : 0);
+}
+
+static int
+loop_run(struct nfs_loop *loop, struct au_rpc_data au_test_data[], int n,
+    const struct au_match *matches, bool found[], int nmatch,
+    long timeout_ms)
+{
+	struct nfs_loop_ctx *ctx;
+	struct rpc_context *rpc;
+	struct timespec start;
+	uint32_t idents[LOOP_MAXEVENTS];
+	int revents[LOOP_MAXEVENTS];
+	ssize_t len;
+	long left;
+	int events, fd, i, missing, nev;
+	u_int c;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &start) == -1)
+		return (-1);
+	for (;;) {
+		/* Records already framed are invisible to the queue */
+		if (loop->aupipe != NULL &&
+		    loop_records(loop, matches, found, nmatch) == -1)
+			return (-1);
+		for (missing = 0, i = 0; i < n; i++)
+			missing += !au_test_data[i].is_finished;
+		for (i = 0; i < nmatch; i++)
+			missing += !found[i];
+		if (missing == 0)
+			return (0);
+		left = -1;
+		if (timeout_ms >= 0 &&
+		    (left = timeout_ms - elapsed_ms(&start)) <= 0)
+			return (missing);
+
+		for (c = 0; c < loop->nctx; c++) {
+			ctx = &loop->ctx[c];
+			rpc = nfs_get_rpc_context(ctx->nfs);
+			fd = rpc_get_fd(rpc);
+			events = rpc_which_events(rpc);
+			if (fd == ctx->fd && events == ctx->events)
+				continue;
+			if (fd != ctx->fd && loop_stale(loop, c, ctx->fd))
+				loop_unwatch(loop, ctx->fd);
+			/* No socket while libnfs reconnects, nothing to watch */
+			if (fd < 0) {
+				ctx->fd = -1;
+				continue;
+			}
+			if (loop_watch(loop, c, fd, events,
+			    fd == ctx->fd) == -1)
+				return (-1);
+			ctx->fd = fd;
+			ctx->events = events;
+		}
+
+		if ((nev = loop_wait(loop, idents, revents, left)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		for (i = 0; i < nev; i++) {
+			if (idents[i] == LOOP_PIPE) {
+				len = au_framer_fill(&loop->aupipe->framer);
+				if (len == -1 && errno != EAGAIN)
+					return (-1);
+				/* The writer is gone, no more records come */
+				if (len == 0) {
+					errno = EPIPE;
+					return (-1);
+				}
+				continue;
+			}
+			if (idents[i] >= loop->nctx)
+				continue;
+			ctx = &loop->ctx[idents[i]];
+			rpc = nfs_get_rpc_context(ctx->nfs);
+			if (rpc_service(rpc, revents[i]) < 0)
+				return (-1);
+			/*
+			 * The socket may have been closed and replaced by
+			 * one of the same number, which is then registered
+			 * again.
+			 */
+			if (revents[i] & (POLLHUP | POLLERR))
+				ctx->fd = -1;
+		}
+	}
+}
+
+/*
+ * Service every context of the loop and its auditpipe until the 'n' RPCs
+ * of au_test_data, issued on any of the contexts, complete and the
+ * 'nmatch' expected records are found in any order, or until timeout_ms
+ * pass, -1 for no limit. found[] tells which records were. Returns how
+ * many RPCs and records are still missing, -1 if a connection failed, a
+ * record is malformed or the auditpipe dropped records. The check of the auditpipe is then over, as with
+ * check_audit_set(), and its counters are recorded.
+ */
+int
+nfs_loop_run(struct nfs_loop *loop, struct au_rpc_data au_test_data[],
+    int n, const struct au_match *matches, bool found[], int nmatch,
+    long timeout_ms)
+{
+	int missing;
+
+	missing = loop_run(loop, au_test_data, n, matches, found, nmatch,
+	    timeout_ms);
+	if (loop->aupipe != NULL) {
+		release_auditpipe(loop->aupipe);
+		loop->aupipe = NULL;
+	}
+	return (missing);
+}
+
+void
+nfs_res_close_cb(__unused struct nfs_context *nfs, int status, void *data, void *private_data)
+{
+	struct au_rpc_data* au_test_data = (struct au_rpc_data *)private_data;
+
+	/* Without a reply, data is an error message or NULL */
+	if (status != RPC_STATUS_SUCCESS)
+		goto out;
 
 	switch (au_test_data->au_rpc_event) {
 	case AUE_NFS3RPC_GETATTR:
@@ -414,6 +2659,8 @@ nfs_res_close_cb(__unused struct nfs_context *nfs, int status, void *data, void
 	default:
 		ATF_REQUIRE_EQ_MSG(0, 1, "unknown RPC event");
 	}
+out:
+	latency_record(au_test_data, status);
 	au_test_data->au_rpc_status = status;
 	au_test_data->is_finished = 1;
 }
@@ -424,7 +2671,9 @@ nfsv4_res_close_cb(__unused struct nfs_context *nfs, int status, void *data, voi
 	struct au_rpc_data* au_test_data = (struct au_rpc_data *)private_data;
 	COMPOUND4res *res = data;
 
-	au_test_data->au_rpc_result = res->status;
+	if (status == RPC_STATUS_SUCCESS)
+		au_test_data->au_rpc_result = res->status;
+	latency_record(au_test_data, status);
 	au_test_data->au_rpc_status = status;
 	au_test_data->is_finished = 1;
 }
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <bsm/audit.h>
 
@@ -17,11 +18,39 @@
 #include <nfsc/libnfs-raw-nfs4.h>
 #include <nfsc/libnfs-raw-portmap.h>
 
+#include "audit_record.h"
+
+struct au_pipe;
+struct nfs_loop;
+struct nfs_pool;
+
 struct au_rpc_data {
 	int	au_rpc_status;
 	int	au_rpc_result; /* RPC result status/error. refer: libnfs-raw-nfs.h */
 	int	au_rpc_event;
 	int	is_finished;
+	struct timespec	submitted;	/* CLOCK_MONOTONIC, see AU_RPC_ASYNC() */
+	struct timespec	completed;
+};
+
+/*
+ * Queue the RPC of data with the rpc_*_async() function fn and stamp it as
+ * submitted if it was, for its latency to be measured. Evaluates to the
+ * error of fn.
+ */
+#define	AU_RPC_ASYNC(fn, rpc, cb, args, data)				\
+	au_rpc_issued((data), fn((rpc), (rpc_cb)(cb), (args), (data)))
+
+/* Latencies of the RPCs of an event in nanoseconds, see rpc_latency_get() */
+#define	RPC_LATENCY_ANY		(-1)
+
+struct rpc_latency {
+	uint64_t	count;
+	uint64_t	timeouts;
+	uint64_t	p50;
+	uint64_t	p99;
+	uint64_t	p999;
+	uint64_t	max;
 };
 
 struct nfs_fh {
@@ -106,9 +135,42 @@ struct nfs_context *tc_body_init(int, struct au_rpc_data *);
 void nfs_res_close_cb(struct nfs_context *, int, void *, void *);
 void nfsv4_res_close_cb(struct nfs_context *, int, void *, void *);
 int nfs_poll_fd(struct nfs_context *, struct au_rpc_data*);
-void check_audit(struct pollfd [], const char *, FILE *);
-FILE *setup(struct pollfd [], const char *);
+int nfs_wait_rpc(struct nfs_context *, struct au_rpc_data *);
+int nfs_wait_rpcs(struct nfs_context *, struct au_rpc_data [], int, long);
+void nfs_teardown(struct nfs_context *);
+void nfs_abandon(struct nfs_context *);
+int nfs_cancel_rpcs(struct nfs_context *, struct au_rpc_data [], int);
+void au_rpc_init(struct au_rpc_data *, int);
+int au_rpc_issued(struct au_rpc_data *, int);
+bool rpc_latency_get(int, struct rpc_latency *);
+void rpc_latency_reset(void);
+void mean_confidence(const double [], int, double *, double *);
+struct nfs_pool *nfs_pool_create(const char *, int, u_int);
+struct nfs_context *nfs_pool_get(struct nfs_pool *);
+void nfs_pool_put(struct nfs_pool *, struct nfs_context *);
+void nfs_pool_discard(struct nfs_pool *, struct nfs_context *);
+void nfs_pool_destroy(struct nfs_pool *);
+struct nfs_loop *nfs_loop_create(struct au_pipe *);
+int nfs_loop_add(struct nfs_loop *, struct nfs_context *);
+int nfs_loop_run(struct nfs_loop *, struct au_rpc_data [], int,
+    const struct au_match *, bool [], int, long);
+void nfs_loop_destroy(struct nfs_loop *);
+void check_audit(struct pollfd [], const char *, struct au_pipe *);
+void check_audit_match(struct pollfd [], const struct au_match *,
+    struct au_pipe *);
+void check_audit_set(struct pollfd [], const struct au_match *, int, bool,
+    struct au_pipe *);
+struct au_pipe *setup(struct pollfd [], const char *);
 void cleanup(void);
+int fixture_mkdir(char *, size_t);
+void fixture_rmdir(const char *);
+void tc_workdir(void);
+void standin_stall(long);
+int fixture_acquire(bool);
+long fixture_acquire_audit(void);
+void fixture_release(void);
+long nfs_probe(bool, long);
+void record_stat(const char *, const char *, uintmax_t);
 
 /*
  * NFSv3 RPC related events